@@ -4,40 +4,107 @@
  */
 
 #include "ALSARecorder.h"
+#include "Realtime.h"
 #include "SoundConfig.h"
+#include "Timing.h"
 #include <alsa/asoundlib.h>
+#include <pthread.h>
+#include <poll.h>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 
-AlsaRecorder::AlsaRecorder(std::function<void (const int16_t*, int, short)> handler)
-    : audioBuffer(NULL), handler(handler), running(false), mPaused(false)
+#define MAX_PENDING_GAPS    (16)    /* drops the DSP thread has not reached yet */
+
+CaptureConfig::CaptureConfig()
+    : device(SOUND_DEVICE_RX), mixerDevice(SOUND_DEVICE_RX_VOL), mixerElement(SOUND_SUBDEVICE_RX),
+      channels(NUM_CHANNELS_RX), sampleRate(SAMPLE_RATE_RX), periodSize(BUFFER_SIZE_RX), periods(0),
+      ringFrames(0), mmap(false), realtimePriority(0), cpu(-1), lockMemory(false)
+{
+}
+
+AlsaRecorder::AlsaRecorder(Handler handler, const CaptureConfig &config)
+    : AudioSource(handler), config(config), audioBuffer(NULL), captureHandle(NULL), mmapActive(false),
+      hwTimestamps(false), canPause(false), hwPaused(false), resumePending(false), totalFrames(0),
+      ring(NULL), gaps(NULL), lastGap(UINT64_MAX), ringMaxFill(0), overruns(0), droppedFrames(0), resumeLatency(0)
 {
+    sem_init(&ringSemaphore, 0, 0);
 }
 
 AlsaRecorder::~AlsaRecorder()
 {
+    sem_destroy(&ringSemaphore);
+}
+
+unsigned AlsaRecorder::getRingFill() const
+{
+    return ring ? static_cast<unsigned>(ring->readable() / config.channels) : 0;
 }
 
 void AlsaRecorder::main()
 {
-    initAlsa();
-    setVolume(SOUND_SUBDEVICE_RX);
+    if(config.lockMemory) {
+        lockMemory();
+    }
+    makeRealtime("capture thread", config.realtimePriority, config.cpu);
+
+    if(!initAlsa()) {
+        if(captureHandle) {
+            destroyAlsa();
+        }
+        return;
+    }
+    setVolume(config.mixerElement.c_str());
 
     running = true;
 
+    if(config.ringFrames > 0) {
+        ring = new RingBuffer<int16_t>(static_cast<size_t>(config.ringFrames) * config.channels);
+        gaps = new RingBuffer<uint64_t>(MAX_PENDING_GAPS);
+        lastGap = UINT64_MAX;
+        dspThread = std::thread(&AlsaRecorder::dspMain, this, config.channels);
+        pthread_setname_np(dspThread.native_handle(), "WhistleDSP");
+    }
+
+    if(mmapActive) {
+        captureMmap();
+    } else {
+        captureReadWrite();
+    }
+
+    if(ring) {
+        running = false;
+        sem_post(&ringSemaphore);
+        dspThread.join();
+
+        std::cout << "ring buffer: " << ringMaxFill << " of " << config.ringFrames << " frames used at most, "
+                  << overruns << " overruns (" << droppedFrames << " frames dropped)." << std::endl;
+        delete ring;
+        ring = NULL;
+        delete gaps;
+        gaps = NULL;
+    }
+
+    destroyAlsa();
+}
+
+void AlsaRecorder::captureReadWrite()
+{
     while(running) {
 
-        // wait if is paused
-        {
-            std::unique_lock<std::mutex> lock(mPausedMutex);
-            if (mPaused) {
-                std::cout<<"paused, waiting...\n";
-                mPausedCondition.wait(lock);
-            }
+        // stop the stream while paused
+        if(isPaused() && !suspendWhilePaused()) {
+            break;
         }
 
         int err;
-        if((err = snd_pcm_readi(captureHandle, audioBuffer, bufferSize)) != bufferSize) {
+        {
+            StageTimer timer(TIMING_READ);
+            err = snd_pcm_readi(captureHandle, audioBuffer, bufferSize);
+        }
+        if(err != bufferSize) {
             std::cerr << "read from audio interface failed " << snd_strerror(err) << std::endl;
 
             /* try to recover */
@@ -50,106 +117,334 @@ void AlsaRecorder::main()
         }
 
         /* process */
-        handler(audioBuffer, bufferSize, NUM_CHANNELS_RX);
+        process(audioBuffer, bufferSize, config.channels);
     }
+}
 
-    destroyAlsa();
+void AlsaRecorder::captureMmap()
+{
+    const int nDescriptors = snd_pcm_poll_descriptors_count(captureHandle);
+    if(nDescriptors <= 0) {
+        std::cerr << "cannot get poll descriptors " << snd_strerror(nDescriptors) << std::endl;
+        return;
+    }
+    std::vector<struct pollfd> descriptors(nDescriptors);
+    snd_pcm_poll_descriptors(captureHandle, descriptors.data(), nDescriptors);
+
+    while(running) {
+
+        // stop the stream while paused
+        if(isPaused() && !suspendWhilePaused()) {
+            break;
+        }
+
+        int err;
+        if(snd_pcm_state(captureHandle) == SND_PCM_STATE_PREPARED) {
+            /* mmap access does not start the stream implicitly */
+            if((err = snd_pcm_start(captureHandle)) < 0) {
+                std::cerr << "cannot start audio interface " << snd_strerror(err) << std::endl;
+                break;
+            }
+        }
+
+        /* wait for a period, time out to notice stop() */
+        unsigned short revents = 0;
+        snd_pcm_sframes_t avail;
+        {
+            StageTimer timer(TIMING_READ);
+            if((err = poll(descriptors.data(), nDescriptors, 1000)) <= 0) {
+                continue;
+            }
+            snd_pcm_poll_descriptors_revents(captureHandle, descriptors.data(), nDescriptors, &revents);
+            avail = snd_pcm_avail_update(captureHandle);
+        }
+        if((revents & POLLERR) || avail < 0) {
+            std::cerr << "mmap capture failed " << snd_strerror(avail < 0 ? avail : -EPIPE) << std::endl;
+
+            /* try to recover */
+            if((err = xrunRecovery(captureHandle, avail < 0 ? avail : -EPIPE)) < 0) {
+                std::cerr << "couldn't recover " << snd_strerror(err) << std::endl;
+                /* exit thread */
+                break;
+            }
+            continue;
+        }
+
+        /* process everything available straight from the DMA area */
+        while(avail > 0) {
+            const snd_pcm_channel_area_t *areas;
+            snd_pcm_uframes_t offset;
+            snd_pcm_uframes_t frames = std::min<snd_pcm_uframes_t>(avail, bufferSize);
+
+            if((err = snd_pcm_mmap_begin(captureHandle, &areas, &offset, &frames)) < 0) {
+                std::cerr << "mmap begin failed " << snd_strerror(err) << std::endl;
+                xrunRecovery(captureHandle, err);
+                break;
+            }
+
+            /* interleaved: all channels share the first area, first and step are in bits */
+            const int16_t *samples = static_cast<const int16_t*>(areas[0].addr) + areas[0].first / 16 + offset * (areas[0].step / 16);
+            process(samples, frames, config.channels);
+
+            const snd_pcm_sframes_t committed = snd_pcm_mmap_commit(captureHandle, offset, frames);
+            if(committed < 0 || static_cast<snd_pcm_uframes_t>(committed) != frames) {
+                std::cerr << "mmap commit failed " << snd_strerror(committed < 0 ? committed : -EPIPE) << std::endl;
+                xrunRecovery(captureHandle, committed < 0 ? committed : -EPIPE);
+                break;
+            }
+            avail -= frames;
+        }
+    }
 }
 
-void AlsaRecorder::stop()
+bool AlsaRecorder::suspendWhilePaused()
 {
-    running = false;
+    /* the hardware stops, no periods and no interrupts while paused */
+    int err;
+    hwPaused = canPause && snd_pcm_pause(captureHandle, 1) == 0;
+    if(!hwPaused && (err = snd_pcm_drop(captureHandle)) < 0) {
+        std::cerr << "cannot stop audio interface " << snd_strerror(err) << std::endl;
+    }
+
+    /* the DSP thread finishes the buffers before the pause, then idles as well */
+    while(ring && !ring->drained() && running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    /* the windows do not continue over the gap, safe here as no buffer is delivered meanwhile */
+    restartSink();
+
+    waitWhilePaused();
+    if(!running) {
+        return false;
+    }
+
+    /* fast path: release the pause and skip what was captured before it */
+    if(hwPaused && snd_pcm_pause(captureHandle, 0) == 0) {
+        const snd_pcm_sframes_t stale = snd_pcm_avail(captureHandle);
+        if(stale > 0) {
+            snd_pcm_forward(captureHandle, stale);
+        }
+    } else if((err = snd_pcm_prepare(captureHandle)) < 0) {
+        std::cerr << "cannot prepare audio interface after pause " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    hwPaused = false;
+    resumePending = true;
+    return true;
 }
 
-bool AlsaRecorder::isRunning() const
+void AlsaRecorder::process(const int16_t *samples, int frames, short channels)
 {
-    return running;
+    if(resumePending) {
+        /* unpause to the first buffer after it */
+        resumePending = false;
+        const uint64_t requested = resumeRequested;
+        const uint64_t now = Timing::now();
+        if(requested && requested <= now) {
+            resumeLatency = now - requested;
+            if(Timing::isEnabled()) {
+                Timing::record(TIMING_RESUME, now - requested);
+            }
+        }
+    }
+
+    if(!ring) {
+        anchorCapture(frames);
+        StageTimer timer(TIMING_BUFFER);
+        deliver(samples, frames, channels);
+        return;
+    }
+
+    if(!ring->write(samples, static_cast<size_t>(frames) * channels)) {
+        /* the DSP thread is behind, never wait for it; it restarts the sink where the frames are missing */
+        ++overruns;
+        droppedFrames += frames;
+        const uint64_t position = ring->written();
+        if(position != lastGap && gaps->write(&position, 1)) {
+            lastGap = position;
+        }
+        return;
+    }
+    anchorCapture(frames);
+
+    const unsigned fill = static_cast<unsigned>(ring->readable() / channels);
+    if(fill > ringMaxFill) {
+        ringMaxFill = fill;
+    }
+    sem_post(&ringSemaphore);
+}
+
+void AlsaRecorder::dspMain(short channels)
+{
+    makeRealtime("DSP thread", config.realtimePriority > 1 ? config.realtimePriority - 1 : config.realtimePriority, config.cpu);
+
+    while(true) {
+        while(sem_wait(&ringSemaphore) < 0 && errno == EINTR) {
+        }
+
+        /* drain everything, at most two contiguous parts, split where buffers were dropped */
+        size_t n;
+        const int16_t *samples = ring->peek(n);
+        while(n > 0) {
+            size_t pending;
+            const uint64_t *gap = gaps->peek(pending);
+            if(pending > 0) {
+                if(*gap == ring->consumed()) {
+                    /* the windows, the detectors and the published spectra do not continue over it */
+                    restartSink();
+                    gaps->consume(1);
+                    continue;
+                }
+                n = std::min(n, static_cast<size_t>(*gap - ring->consumed()));
+            }
+            StageTimer timer(TIMING_BUFFER);
+            deliver(samples, static_cast<int>(n / channels), channels);
+            ring->consume(n);
+            samples = ring->peek(n);
+        }
+
+        if(!running) {
+            break;
+        }
+    }
 }
 
-void AlsaRecorder::setListeningPaused(bool paused) {
-    std::unique_lock<std::mutex> lock(mPausedMutex);
-    if (mPaused == paused) {
-        // nothing to do
+void AlsaRecorder::anchorCapture(int frames)
+{
+    totalFrames += frames;
+    if(!Timing::isAnchoring()) {
         return;
     }
 
-    mPaused = paused;
-    if (!mPaused) {
-        std::cout<<"unpaused!\n";
-        mPausedCondition.notify_one();
+    uint64_t captured = Timing::now();
+    snd_pcm_uframes_t avail;
+    snd_htimestamp_t ts;
+    if(hwTimestamps && snd_pcm_htimestamp(captureHandle, &avail, &ts) == 0 && (ts.tv_sec || ts.tv_nsec)) {
+        /* at ts the hardware was avail frames ahead of the application pointer, which is
+         * still at the begin of the frames in the DMA area until they are committed */
+        const snd_pcm_uframes_t pending = mmapActive ? frames : 0;
+        const uint64_t ahead = avail > pending ? avail - pending : 0;
+        captured = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec
+                   - ahead * 1000000000ull / config.sampleRate;
     }
+    Timing::setCaptureAnchor(totalFrames, captured, config.sampleRate);
 }
 
 /*******************************************************************/
-void AlsaRecorder::initAlsa()
+bool AlsaRecorder::initAlsa()
 {
     if(audioBuffer) {
         std::cerr << "Double initialization" << std::endl;
-        return;
+        return false;
     }
 
     int err;
     snd_pcm_hw_params_t *hwParams;
 
-    bufferSize = BUFFER_SIZE_RX;
+    bufferSize = config.periodSize;
 
-    if((err = snd_pcm_open(&captureHandle, SOUND_DEVICE_RX, SND_PCM_STREAM_CAPTURE, 0)) < 0) {
-        std::cerr << "cannot open audio device " << SOUND_DEVICE_RX << "(" << snd_strerror(err) << ")" << std::endl;
-        return;
+    if((err = snd_pcm_open(&captureHandle, config.device.c_str(), SND_PCM_STREAM_CAPTURE, 0)) < 0) {
+        std::cerr << "cannot open audio device " << config.device << "(" << snd_strerror(err) << ")" << std::endl;
+        captureHandle = NULL;
+        return false;
     }
 
     if((err = snd_pcm_hw_params_malloc(&hwParams)) < 0) {
         std::cerr << "cannot allocate hardware parameter structure " << snd_strerror(err) << std::endl;;
-        return;
+        return false;
     }
 
     if((err = snd_pcm_hw_params_any(captureHandle, hwParams)) < 0) {
         std::cerr << "cannot initialize hardware parameter structure " << snd_strerror(err) << std::endl;
-        return;
+        return false;
     }
 
-    if((err = snd_pcm_hw_params_set_access(captureHandle, hwParams, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
+    mmapActive = false;
+    if(config.mmap) {
+        if((err = snd_pcm_hw_params_set_access(captureHandle, hwParams, SND_PCM_ACCESS_MMAP_INTERLEAVED)) < 0) {
+            std::cerr << "cannot set mmap access, falling back to read/write " << snd_strerror(err) << std::endl;
+        } else {
+            mmapActive = true;
+        }
+    }
+    if(!mmapActive && (err = snd_pcm_hw_params_set_access(captureHandle, hwParams, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
         std::cerr << "cannot set access type " << snd_strerror(err) << std::endl;
-        return;
+        return false;
     }
 
     if((err = snd_pcm_hw_params_set_format(captureHandle, hwParams, SND_PCM_FORMAT_S16_LE)) < 0) {
         std::cerr << "cannot set sample format " << snd_strerror(err) << std::endl;
-        return;
+        return false;
     }
 
     unsigned oSR;
-    oSR = SAMPLE_RATE_RX;
+    oSR = config.sampleRate;
     if((err = snd_pcm_hw_params_set_rate_near(captureHandle, hwParams, &oSR, 0)) < 0) {
         std::cerr << "cannot set sample rate " << snd_strerror(err) << std::endl;
-        return;
+        return false;
     }
 
-    if(oSR != SAMPLE_RATE_RX) {
-        std::cerr << "cannot set sample rate, correct should be: " << SAMPLE_RATE_RX << ", is " << oSR << std::endl;
-        return;
+    if(oSR != config.sampleRate) {
+        std::cerr << "cannot set sample rate, correct should be: " << config.sampleRate << ", is " << oSR << std::endl;
+        return false;
     }
 
-    std::cout << "ALSA-RX opened with a samplerate of " << oSR << " (requested: " << SAMPLE_RATE_RX << ")." << std::endl;
+    std::cout << "ALSA-RX opened with a samplerate of " << oSR << " (requested: " << config.sampleRate << ")"
+              << (mmapActive ? ", mmap access." : ".") << std::endl;
 
-    if((err = snd_pcm_hw_params_set_channels(captureHandle, hwParams, NUM_CHANNELS_RX)) < 0) {
+    if((err = snd_pcm_hw_params_set_channels(captureHandle, hwParams, config.channels)) < 0) {
         std::cerr << "cannot set channel count " << snd_strerror(err) << std::endl;
-        return;
+        return false;
+    }
+
+    snd_pcm_uframes_t periodSize = config.periodSize;
+    if((err = snd_pcm_hw_params_set_period_size_near(captureHandle, hwParams, &periodSize, 0)) < 0) {
+        std::cerr << "cannot set period size " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    if(config.periods > 0) {
+        unsigned periods = config.periods;
+        if((err = snd_pcm_hw_params_set_periods_near(captureHandle, hwParams, &periods, 0)) < 0) {
+            std::cerr << "cannot set number of periods " << snd_strerror(err) << std::endl;
+            return false;
+        }
     }
 
     if((err = snd_pcm_hw_params(captureHandle, hwParams)) < 0) {
         std::cerr << "cannot set parameters " << snd_strerror(err) << std::endl;
-        return;
+        return false;
     }
 
+    snd_pcm_uframes_t alsaBufferSize = 0;
+    snd_pcm_hw_params_get_period_size(hwParams, &periodSize, 0);
+    snd_pcm_hw_params_get_buffer_size(hwParams, &alsaBufferSize);
+    canPause = snd_pcm_hw_params_can_pause(hwParams) == 1;
+    std::cout << "ALSA-RX period of " << periodSize << " frames (requested: " << config.periodSize << "), buffer of "
+              << alsaBufferSize << " frames." << std::endl;
+
     snd_pcm_hw_params_free(hwParams);
 
+    /* timestamps for the latency measurement, not fatal */
+    hwTimestamps = false;
+    snd_pcm_sw_params_t *swParams;
+    if(snd_pcm_sw_params_malloc(&swParams) == 0) {
+        if(snd_pcm_sw_params_current(captureHandle, swParams) == 0
+           && snd_pcm_sw_params_set_tstamp_mode(captureHandle, swParams, SND_PCM_TSTAMP_ENABLE) == 0) {
+#if SND_LIB_VERSION >= 0x01001c
+            hwTimestamps = snd_pcm_sw_params_set_tstamp_type(captureHandle, swParams, SND_PCM_TSTAMP_TYPE_MONOTONIC) == 0
+                           && snd_pcm_sw_params(captureHandle, swParams) == 0;
+#endif
+        }
+        snd_pcm_sw_params_free(swParams);
+    }
+
     if((err = snd_pcm_prepare(captureHandle)) < 0) {
         std::cerr << "cannot prepare audio interface for use " << snd_strerror(err) << std::endl;
-        return;
+        return false;
     }
 
-    audioBuffer = new int16_t[NUM_CHANNELS_RX * bufferSize];
+    audioBuffer = new int16_t[config.channels * bufferSize];
+    return true;
 }
 
 void AlsaRecorder::setVolume(const char *subdevice)
@@ -165,7 +460,7 @@ void AlsaRecorder::setVolume(const char *subdevice)
         std::cerr << "unable to open mixer " << snd_strerror(err) << std::endl;
         return;
     }
-    if((err = snd_mixer_attach(mixer, SOUND_DEVICE_RX_VOL)) < 0) {
+    if((err = snd_mixer_attach(mixer, config.mixerDevice.c_str())) < 0) {
         std::cerr << "unable to attach card to mixer " << snd_strerror(err) << std::endl;
         return;
     }
@@ -221,7 +516,7 @@ int AlsaRecorder::xrunRecovery(snd_pcm_t *handle, int err)
 
 void AlsaRecorder::destroyAlsa()
 {
-    if(!audioBuffer) {
+    if(!captureHandle) {
         std::cerr << "Not initialized!" << std::endl;
         return;
     }
@@ -230,6 +525,8 @@ void AlsaRecorder::destroyAlsa()
 
     snd_pcm_drop(captureHandle);
     snd_pcm_close(captureHandle);
+    captureHandle = NULL;
 
-    delete audioBuffer;
+    delete[] audioBuffer;
+    audioBuffer = NULL;
 }
@@ -6,44 +6,98 @@
 #ifndef __AK_ALSA_RECORDER__
 #define __AK_ALSA_RECORDER__
 
+#include "AudioSource.h"
+#include "RingBuffer.h"
 #include <alsa/asoundlib.h>
+#include <semaphore.h>
+#include <atomic>
+#include <string>
+#include <thread>
 #include <vector>
-#include <functional>
-#include <mutex>
-#include <condition_variable>
 
-class AlsaRecorder
+/* capture parameters, defaults from SoundConfig.h */
+struct CaptureConfig
+{
+    CaptureConfig();
+
+    std::string device;         /* PCM to capture from */
+    std::string mixerDevice;    /* mixer for the capture volume */
+    std::string mixerElement;
+    short channels;
+    unsigned sampleRate;
+    int periodSize;             /* frames per period and per handler call */
+    unsigned periods;           /* periods in the ALSA buffer, 0: driver default */
+
+    /* > 0: the handler runs in a separate DSP thread fed through a ring buffer of that many
+     * frames, the capture thread never waits for it and drops buffers if the ring is full */
+    int ringFrames;
+    /* hand the DMA area to the handler instead of copying, falls back to read/write */
+    bool mmap;
+
+    /* SCHED_FIFO priority of the capture thread (the DSP thread gets one less), 0: off */
+    int realtimePriority;
+    int cpu;                    /* pin capture and DSP thread to this cpu, -1: off */
+    bool lockMemory;            /* mlockall the whole process */
+};
+
+class AlsaRecorder : public AudioSource
 {
 public:
     /* handler: samples, count, channels */
-    AlsaRecorder(std::function<void (const int16_t*, int, short)> handler);
+    AlsaRecorder(Handler handler, const CaptureConfig &config = CaptureConfig());
     virtual ~AlsaRecorder();
 
-    void main();
-    void stop();
-    void setListeningPaused(bool paused);
+    virtual void main();
 
-    bool isRunning() const;
-    bool isPaused() const { return mPaused; }
+    /* ring buffer statistics, in frames */
+    unsigned getRingFill() const;
+    unsigned getRingMaxFill() const { return ringMaxFill; }
+    unsigned long getOverruns() const { return overruns; }
+    unsigned long getDroppedFrames() const { return droppedFrames; }
+    /* from the last unpause to the first captured buffer, in ns (0: not resumed yet) */
+    uint64_t getResumeLatency() const { return resumeLatency; }
 
 protected:
-    void initAlsa();
+    bool initAlsa();
     void setVolume(const char *subdevice);
     void destroyAlsa();
 
     int xrunRecovery(snd_pcm_t *handle, int err);
+    /* pauses (or drops) the stream while paused and resumes it without stale frames,
+     * false if the stream could not be resumed or the source was stopped */
+    bool suspendWhilePaused();
+
+    void captureReadWrite();
+    void captureMmap();
+
+    /* hands captured frames to the handler, directly or through the ring */
+    void process(const int16_t *samples, int frames, short channels);
+    /* maps the frames handed to the handler so far to their capture time */
+    void anchorCapture(int frames);
+    void dspMain(short channels);
+
+    const CaptureConfig config;
 
     int16_t *audioBuffer;
     int bufferSize;
 
     snd_pcm_t *captureHandle;
+    bool mmapActive;
+    bool hwTimestamps;          /* monotonic timestamps from the driver */
+    bool canPause;              /* snd_pcm_pause, otherwise drop and prepare */
+    bool hwPaused;
+    bool resumePending;         /* the next buffer is the first after a pause */
+    uint64_t totalFrames;
 
-    std::function<const void (int16_t*, int, short)> handler;
-    volatile bool running;
-
-    std::mutex mPausedMutex;
-    std::condition_variable mPausedCondition;
-    bool mPaused;
+    RingBuffer<int16_t> *ring;
+    /* ring positions where dropped buffers are missing, the DSP thread restarts the sink there */
+    RingBuffer<uint64_t> *gaps;
+    uint64_t lastGap;
+    sem_t ringSemaphore;
+    std::thread dspThread;
+    std::atomic<unsigned> ringMaxFill;
+    std::atomic<unsigned long> overruns, droppedFrames;
+    std::atomic<uint64_t> resumeLatency;
 };
 
 #endif
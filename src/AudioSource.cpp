@@ -0,0 +1,58 @@
+/*!
+ * \brief Common interface of everything that delivers interleaved S16 sound data.
+ */
+
+#include "AudioSource.h"
+#include "Timing.h"
+#include <chrono>
+#include <iostream>
+
+#define PAUSE_POLL_MS   (100)   /* stop() cannot notify (signal handlers), a paused source checks */
+
+AudioSource::AudioSource(Handler handler)
+    : handler(handler), running(false), mPaused(false), resumeRequested(0)
+{
+}
+
+AudioSource::~AudioSource()
+{
+}
+
+void AudioSource::stop()
+{
+    running = false;
+}
+
+bool AudioSource::isRunning() const
+{
+    return running;
+}
+
+void AudioSource::setListeningPaused(bool paused) {
+    std::unique_lock<std::mutex> lock(mPausedMutex);
+    if (mPaused == paused) {
+        // nothing to do
+        return;
+    }
+
+    mPaused = paused;
+    if (!mPaused) {
+        std::cout<<"unpaused!\n";
+        resumeRequested = Timing::now();
+        mPausedCondition.notify_all();
+    }
+}
+
+bool AudioSource::waitWhilePaused()
+{
+    if (!mPaused) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(mPausedMutex);
+    std::cout<<"paused, waiting...\n";
+    /* spurious wakeups and stop() while paused */
+    while (mPaused && running) {
+        mPausedCondition.wait_for(lock, std::chrono::milliseconds(PAUSE_POLL_MS));
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+/*!
+ * \brief Common interface of everything that delivers interleaved S16 sound data.
+ */
+
+#ifndef __AK_AUDIO_SOURCE__
+#define __AK_AUDIO_SOURCE__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <condition_variable>
+
+class AudioSource
+{
+public:
+    /* handler: samples, count, channels */
+    typedef std::function<void (const int16_t*, int, short)> Handler;
+
+    AudioSource(Handler handler);
+    virtual ~AudioSource();
+
+    /* blocks until the source is exhausted or stop() was called */
+    virtual void main() = 0;
+
+    void stop();
+    void setListeningPaused(bool paused);
+
+    bool isRunning() const;
+    bool isPaused() const { return mPaused; }
+
+protected:
+    /* blocks while the source is paused and running, returns true if it was paused */
+    bool waitWhilePaused();
+    /* hands a buffer to the handler */
+    virtual void deliver(const int16_t *samples, int count, short channels) { handler(samples, count, channels); }
+    /* the next buffer does not continue the last one (capture suspended), nothing for a Handler */
+    virtual void restartSink() {}
+
+    Handler handler;
+    std::atomic<bool> running;    /* also stopped from signal handlers and other threads */
+
+    std::mutex mPausedMutex;
+    std::condition_variable mPausedCondition;
+    std::atomic<bool> mPaused;    /* checked without the lock for every buffer */
+    std::atomic<uint64_t> resumeRequested;  /* Timing::now() of the last unpause */
+};
+
+/* a source that calls sink.newData directly instead of a Handler (and sink.restart after a suspend),
+ * e.g. SinkSource<AlsaRecorder, STFT> */
+template<class Source, class Sink>
+class SinkSource : public Source
+{
+public:
+    /* args: the constructor arguments of Source after the handler */
+    template<typename... Args>
+    SinkSource(Sink &sink, Args&&... args)
+        : Source(AudioSource::Handler(), std::forward<Args>(args)...), sink(sink)
+    {
+    }
+
+protected:
+    virtual void deliver(const int16_t *samples, int count, short channels) { sink.newData(samples, count, channels); }
+    virtual void restartSink() { sink.restart(); }
+
+    Sink &sink;
+};
+
+#endif
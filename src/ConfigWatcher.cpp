@@ -0,0 +1,128 @@
+/*!
+ * \brief Calls back when a config file was rewritten (inotify on its directory, so editors
+ *        that replace the file are noticed as well).
+ */
+
+#include "ConfigWatcher.h"
+#include <sys/inotify.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#define SETTLE_TIME_MS      (200)   /* writes closer than this are one change */
+
+ConfigWatcher::ConfigWatcher(const std::string &path, std::function<void ()> changed)
+    : path(path), changed(changed), inotifyFd(-1)
+{
+    stopPipe[0] = stopPipe[1] = -1;
+
+    const size_t slash = path.rfind('/');
+    if(slash == std::string::npos) {
+        directory   = ".";
+        name        = path;
+    } else {
+        directory   = slash ? path.substr(0, slash) : "/";
+        name        = path.substr(slash + 1);
+    }
+}
+
+ConfigWatcher::~ConfigWatcher()
+{
+    stop();
+}
+
+bool ConfigWatcher::start()
+{
+    if(inotifyFd >= 0) {
+        std::cerr << "Double initialization" << std::endl;
+        return false;
+    }
+
+    inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if(inotifyFd < 0) {
+        std::cerr << "cannot initialize inotify (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    if(inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << "cannot watch " << directory << " (" << strerror(errno) << ")" << std::endl;
+        close(inotifyFd);
+        inotifyFd = -1;
+        return false;
+    }
+    if(pipe(stopPipe) < 0) {
+        std::cerr << "cannot create pipe (" << strerror(errno) << ")" << std::endl;
+        close(inotifyFd);
+        inotifyFd = -1;
+        return false;
+    }
+
+    thread = std::thread(&ConfigWatcher::main, this);
+    pthread_setname_np(thread.native_handle(), "WhistleConfig");
+    std::cout << "Watching " << path << " for changes." << std::endl;
+    return true;
+}
+
+void ConfigWatcher::stop()
+{
+    if(thread.joinable()) {
+        const char c = 0;
+        if(write(stopPipe[1], &c, 1) < 0) {
+            std::cerr << "cannot stop config watcher" << std::endl;
+        }
+        thread.join();
+    }
+    if(inotifyFd >= 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+    for(int i = 0; i < 2; ++i) {
+        if(stopPipe[i] >= 0) {
+            close(stopPipe[i]);
+            stopPipe[i] = -1;
+        }
+    }
+}
+
+void ConfigWatcher::main()
+{
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool pending = false;
+
+    while(true) {
+        struct pollfd fds[2] = {
+            {inotifyFd,   POLLIN, 0},
+            {stopPipe[0], POLLIN, 0}
+        };
+        /* after a change wait until the writes settle */
+        const int ready = poll(fds, 2, pending ? SETTLE_TIME_MS : -1);
+        if(ready < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            std::cerr << "cannot poll inotify (" << strerror(errno) << ")" << std::endl;
+            break;
+        }
+        if(fds[1].revents) {
+            break;
+        }
+        if(ready == 0) {
+            pending = false;
+            changed();
+            continue;
+        }
+
+        ssize_t length;
+        while((length = read(inotifyFd, events, sizeof(events))) > 0) {
+            for(char *p = events; p < events + length; ) {
+                const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(p);
+                if(event->len && name == event->name) {
+                    pending = true;
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+}
@@ -0,0 +1,35 @@
+/*!
+ * \brief Calls back when a config file was rewritten (inotify on its directory, so editors
+ *        that replace the file are noticed as well).
+ */
+
+#ifndef __AK_CONFIG_WATCHER__
+#define __AK_CONFIG_WATCHER__
+
+#include <functional>
+#include <string>
+#include <thread>
+
+class ConfigWatcher
+{
+public:
+    /* changed is called from the watcher thread, once per burst of writes */
+    ConfigWatcher(const std::string &path, std::function<void ()> changed);
+    ~ConfigWatcher();
+
+    bool start();
+    void stop();
+
+protected:
+    void main();
+
+    const std::string path;
+    std::string directory, name;
+    std::function<void ()> changed;
+
+    int inotifyFd;
+    int stopPipe[2];
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,71 @@
+/*!
+ * \brief Polyphase FIR decimation by an integer factor, so the transforms run at the rate of
+ *        the band of interest instead of the native rate of the sound card.
+ */
+
+#include "Decimator.h"
+#include "Kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define BLOCK_FRAMES    (1024)
+#define CUTOFF          (0.42)  /* of the output sample rate, the transition band ends near 0.5 */
+
+Decimator::Decimator(int factor, short channels, int tapsPerPhase)
+    : factor(factor), channels(channels), nTaps(factor * tapsPerPhase),
+      taps(nTaps), lines(static_cast<size_t>(channels) * (nTaps - 1 + BLOCK_FRAMES), 0.0f),
+      lineLength(nTaps - 1 + BLOCK_FRAMES), next(0)
+{
+    /* Blackman windowed sinc, only every factor-th output is computed (the polyphase form of
+     * the decimating filter) */
+    const double fc = CUTOFF / factor;
+    const double center = (nTaps - 1) / 2.0;
+    double sum = 0.0;
+    for(int i = 0; i < nTaps; ++i) {
+        const double t = i - center;
+        const double sinc = t == 0.0 ? 2.0 * fc : std::sin(2.0 * M_PI * fc * t) / (M_PI * t);
+        const double window = 0.42 - 0.5 * std::cos(2.0 * M_PI * i / (nTaps - 1)) + 0.08 * std::cos(4.0 * M_PI * i / (nTaps - 1));
+        taps[nTaps - 1 - i] = static_cast<float>(sinc * window);
+        sum += sinc * window;
+    }
+    for(int i = 0; i < nTaps; ++i) {
+        taps[i] = static_cast<float>(taps[i] / sum);
+    }
+}
+
+void Decimator::reset()
+{
+    std::fill(lines.begin(), lines.end(), 0.0f);
+    next = 0;
+}
+
+int Decimator::process(const int16_t *in, int frames, int16_t *out)
+{
+    int nOut = 0;
+    while(frames > 0) {
+        const int n = std::min(frames, BLOCK_FRAMES);
+        for(short c = 0; c < channels; ++c) {
+            convertInt16(in + c, channels, &lines[c * lineLength] + nTaps - 1, n);
+        }
+
+        /* output frame at input frame i is the filter over the frames i - nTaps + 1 ... i */
+        int i = next;
+        for(; i < n; i += factor) {
+            for(short c = 0; c < channels; ++c) {
+                const float y = dotProduct(&taps[0], &lines[c * lineLength] + i, nTaps) * 32768.0f;
+                out[nOut * channels + c] = static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, std::round(y))));
+            }
+            ++nOut;
+        }
+        next = i - n;
+
+        for(short c = 0; c < channels; ++c) {
+            float *line = &lines[c * lineLength];
+            memmove(line, line + n, (nTaps - 1) * sizeof(float));
+        }
+        in     += n * channels;
+        frames -= n;
+    }
+    return nOut;
+}
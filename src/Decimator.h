@@ -0,0 +1,38 @@
+/*!
+ * \brief Polyphase FIR decimation by an integer factor, so the transforms run at the rate of
+ *        the band of interest instead of the native rate of the sound card.
+ */
+
+#ifndef __AK_DECIMATOR__
+#define __AK_DECIMATOR__
+
+#include <cstdint>
+#include <vector>
+
+class Decimator
+{
+public:
+    /* factor: input frames per output frame, all channels of interleaved S16 are filtered,
+     * tapsPerPhase: filter length per output sample (longer: steeper transition band) */
+    Decimator(int factor, short channels, int tapsPerPhase = 24);
+
+    /* writes at most frames / factor + 1 output frames to out, returns their number */
+    int process(const int16_t *in, int frames, int16_t *out);
+    void reset();
+
+    int getFactor() const { return factor; }
+    short getChannels() const { return channels; }
+    int getTaps() const { return nTaps; }
+
+protected:
+    const int factor;
+    const short channels;
+    const int nTaps;
+
+    std::vector<float> taps;    /* reversed, unit gain at DC */
+    std::vector<float> lines;   /* per channel: nTaps - 1 frames of history, then a block of input */
+    const int lineLength;
+    int next;                   /* input frames until the next output frame */
+};
+
+#endif
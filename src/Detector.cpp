@@ -0,0 +1,182 @@
+/*!
+ * \brief Whistle decision on top of magnitude spectra: a band has to stick out of the
+ *        spectrum for a number of consecutive frames.
+ */
+
+#include "Detector.h"
+#include "Kernels.h"
+#include <algorithm>
+#include <cmath>
+
+void calcMeanDeviation(const float *data, int length, float &mean, float &dev)
+{
+    meanDeviation(data, length, mean, dev);
+}
+
+void calcFixedStatistics(const uint32_t *data, int length, FixedSpectrumStatistics &stats)
+{
+    /* length * sum of squares has to fit: 2 * (bits + log2(length)) <= 62 */
+    uint32_t largest = 0;
+    for(int i = 0; i < length; ++i) {
+        largest = std::max(largest, data[i]);
+    }
+    int lengthBits = 0;
+    while((1 << lengthBits) < length) {
+        ++lengthBits;
+    }
+    int shift = 0;
+    while(2 * (32 - __builtin_clz((largest >> shift) | 1) + lengthBits) > 62) {
+        ++shift;
+    }
+
+    uint64_t sum = 0, sumSquared = 0;
+    for(int i = 0; i < length; ++i) {
+        const uint64_t x = data[i] >> shift;
+        sum        += x;
+        sumSquared += x * x;
+    }
+    stats.length = length;
+    stats.shift = shift;
+    stats.sum = static_cast<int64_t>(sum);
+    stats.spread = integerSqrt(length * sumSquared - sum * sum);
+}
+
+Detector::Detector(int binBegin, int binEnd, float threshold, unsigned okayFrames, unsigned missFrames)
+    : binBegin(binBegin), binEnd(binEnd), threshold(threshold),
+      fixedThreshold(std::lround(threshold * 256.0f)), okayFrames(okayFrames), missFrames(missFrames),
+      whistleCounter(0), whistleMissCounter(0), whistleDone(false),
+      frame(0), onsetFrame(0), confidence(0.0f)
+{
+}
+
+void Detector::setNoiseFloor(NoiseFloorMode mode, int frames, float percentile)
+{
+    if(mode == NOISE_FLOOR_FRAME) {
+        noiseFloor.reset();
+    } else {
+        noiseFloor.reset(new NoiseFloor(binEnd - binBegin, mode, frames, percentile));
+        floatBand.resize(binEnd - binBegin);
+    }
+}
+
+bool Detector::handleSpectrum(const float *spectrum, int length)
+{
+    /* the tracked floor needs no statistics of the whole spectrum */
+    if(noiseFloor) {
+        return update(noiseFloor->update(spectrum + binBegin, threshold));
+    }
+
+    float mean, dev;
+    calcMeanDeviation(spectrum, length, mean, dev);
+
+    return handleBand(spectrum + binBegin, mean, dev);
+}
+
+bool Detector::handleBand(const float *band, float mean, float dev)
+{
+    if(noiseFloor) {
+        return update(noiseFloor->update(band, threshold));
+    }
+
+    return update(isAbove(band, mean, dev));
+}
+
+bool Detector::handleFixedSpectrum(const uint32_t *spectrum, int length)
+{
+    FixedSpectrumStatistics stats = {0, 0, 0, 0};
+    if(!noiseFloor) {
+        calcFixedStatistics(spectrum, length, stats);
+    }
+    return handleFixedBand(spectrum + binBegin, stats);
+}
+
+bool Detector::handleFixedBand(const uint32_t *band, const FixedSpectrumStatistics &stats)
+{
+    if(noiseFloor) {
+        /* the floor trackers are float, in the units of the float STFT */
+        for(int i = 0; i < binEnd - binBegin; ++i) {
+            floatBand[i] = band[i] * (1.0f / 32768.0f);
+        }
+        return update(noiseFloor->update(&floatBand[0], threshold));
+    }
+
+    return update(isAbove(band, stats));
+}
+
+bool Detector::isAbove(const float *band, float mean, float dev) const
+{
+    const float whistleThresh = mean + threshold * dev;
+    for(int i = 0; i < binEnd - binBegin; ++i) {
+        if(band[i] > whistleThresh) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Detector::isAbove(const uint32_t *band, const FixedSpectrumStatistics &stats) const
+{
+    /* x > mean + threshold * dev is length * x - sum > threshold * spread */
+    const int64_t whistleThresh = 256 * stats.sum + fixedThreshold * stats.spread;
+    for(int i = 0; i < binEnd - binBegin; ++i) {
+        if(256 * stats.length * static_cast<int64_t>(band[i] >> stats.shift) > whistleThresh) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Detector::update(bool found)
+{
+    const uint64_t current = frame++;
+    if(whistleDone) {
+        if(!found) {
+            ++whistleMissCounter;
+            if(whistleMissCounter > missFrames) {
+                reset();
+            }
+        }
+    }
+    else
+    {
+        if(found) {
+            if(whistleCounter == 0) {
+                onsetFrame = current;
+            }
+            ++whistleCounter;
+            whistleMissCounter = 0;
+        } else if(whistleCounter > 0) {
+            ++whistleMissCounter;
+            if(whistleMissCounter > missFrames) {
+                reset();
+            }
+        }
+        if(whistleCounter >= okayFrames) {
+            /* after a reload the onset is later than the real one */
+            confidence = std::min(1.0f, static_cast<float>(whistleCounter) / (current - onsetFrame + 1));
+            whistleCounter = 0;
+            whistleMissCounter = 0;
+            whistleDone = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Detector::reset()
+{
+    whistleCounter = 0;
+    whistleMissCounter = 0;
+    whistleDone = false;
+}
+
+void Detector::continueFrom(const Detector &previous)
+{
+    whistleCounter = previous.whistleCounter;
+    whistleMissCounter = previous.whistleMissCounter;
+    whistleDone = previous.whistleDone;
+    onsetFrame = frame;
+    if(noiseFloor && previous.noiseFloor) {
+        noiseFloor->continueFrom(*previous.noiseFloor);
+    }
+}
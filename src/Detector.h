@@ -0,0 +1,78 @@
+/*!
+ * \brief Whistle decision on top of magnitude spectra: a band has to stick out of the
+ *        spectrum for a number of consecutive frames.
+ */
+
+#ifndef __AK_DETECTOR__
+#define __AK_DETECTOR__
+
+#include "NoiseFloor.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/* mean and standard deviation of a magnitude spectrum */
+void calcMeanDeviation(const float *data, int length, float &mean, float &dev);
+
+/* the same for integer magnitudes (FixedSTFT), kept as exact sums: the magnitudes shifted
+ * right by shift, their sum and sqrt(length * sum of squares - sum^2) */
+struct FixedSpectrumStatistics
+{
+    int length;
+    int shift;
+    int64_t sum;
+    int64_t spread;
+};
+void calcFixedStatistics(const uint32_t *data, int length, FixedSpectrumStatistics &stats);
+
+class Detector
+{
+public:
+    /* band: bins [binBegin, binEnd), threshold: multiples of the deviation above the mean */
+    Detector(int binBegin, int binEnd, float threshold, unsigned okayFrames, unsigned missFrames);
+
+    /* full magnitude spectrum, returns true if a whistle was just detected */
+    bool handleSpectrum(const float *spectrum, int length);
+    /* magnitudes of the band only together with the statistics of the whole spectrum */
+    bool handleBand(const float *band, float mean, float dev);
+    /* integer magnitudes: the threshold test in integers, in steps of 1/256 of the deviation */
+    bool handleFixedSpectrum(const uint32_t *spectrum, int length);
+    bool handleFixedBand(const uint32_t *band, const FixedSpectrumStatistics &stats);
+    /* the test of a single frame, without counting it */
+    bool isAbove(const float *band, float mean, float dev) const;
+    bool isAbove(const uint32_t *band, const FixedSpectrumStatistics &stats) const;
+    /* tracks the floor of every band bin instead of using the statistics of each spectrum,
+     * see NoiseFloor (NOISE_FLOOR_FRAME: back to the spectrum statistics) */
+    void setNoiseFloor(NoiseFloorMode mode, int frames, float percentile = 0.5f);
+    /* a frame with or without whistle */
+    bool update(bool found);
+
+    void reset();
+    /* takes over a whistle in progress (after a reload), its onset becomes the current frame */
+    void continueFrom(const Detector &previous);
+
+    /* frame of the first whistle frame of the last detection, counted from the first frame */
+    uint64_t getOnsetFrame() const { return onsetFrame; }
+    /* frames handled so far */
+    uint64_t getFrames() const { return frame; }
+    /* share of the frames from the onset to the last detection in which the band stood out */
+    float getConfidence() const { return confidence; }
+
+    int getBinBegin() const { return binBegin; }
+    int getBinEnd() const { return binEnd; }
+
+protected:
+    const int binBegin, binEnd;
+    const float threshold;
+    const int64_t fixedThreshold;   /* threshold * 256 */
+    const unsigned okayFrames, missFrames;
+
+    unsigned whistleCounter, whistleMissCounter;
+    bool whistleDone;
+    uint64_t frame, onsetFrame;
+    float confidence;
+    std::unique_ptr<NoiseFloor> noiseFloor;
+    std::vector<float> floatBand;   /* integer band for the noise floor */
+};
+
+#endif
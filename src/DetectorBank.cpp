@@ -0,0 +1,81 @@
+/*!
+ * \brief The whistle decision of Detector for many independent streams at once, the state is
+ *        stored as structure of arrays so one frame of all streams is a vectorizable loop.
+ */
+
+#include "DetectorBank.h"
+
+DetectorBank::DetectorBank(int streams, float threshold, unsigned okayFrames, unsigned missFrames)
+    : streams(streams), threshold(threshold), okayFrames(okayFrames), missFrames(missFrames),
+      peaks(streams, 0.0f), means(streams, 0.0f), deviations(streams, 0.0f), active(streams, 0),
+      whistleCounter(streams, 0), whistleMissCounter(streams, 0), whistleDone(streams, 0),
+      detected(streams, 0), started(streams, 0), frames(streams, 0), onsetFrames(streams, 0)
+{
+}
+
+void DetectorBank::reset()
+{
+    for(int s = 0; s < streams; ++s) {
+        whistleCounter[s]       = 0;
+        whistleMissCounter[s]   = 0;
+        whistleDone[s]          = 0;
+        detected[s]             = 0;
+        started[s]              = 0;
+        frames[s]               = 0;
+        onsetFrames[s]          = 0;
+    }
+}
+
+/* Detector::update without branches (all conditions are 0 or 1), inactive streams keep their
+ * state; the arrays must not overlap, which lets the compiler vectorize across streams */
+static uint32_t updateStreams(int n, float threshold, uint32_t okayFrames, uint32_t missFrames,
+                              const float *__restrict peak, const float *__restrict mean,
+                              const float *__restrict dev, const uint32_t *__restrict on,
+                              uint32_t *__restrict counter, uint32_t *__restrict miss,
+                              uint32_t *__restrict done, uint32_t *__restrict hit, uint32_t *__restrict onset)
+{
+    uint32_t nDetected = 0;
+    for(int s = 0; s < n; ++s) {
+        const uint32_t found    = peak[s] > mean[s] + threshold * dev[s];
+        const uint32_t isOn     = on[s];
+        const uint32_t wasDone  = done[s];
+        const uint32_t c        = counter[s];
+        const uint32_t m        = miss[s];
+
+        /* a miss counts after a detection or after the first whistle frame */
+        const uint32_t missed   = (found ^ 1) & (wasDone | (c > 0));
+        const uint32_t counted  = found & (wasDone ^ 1);
+        uint32_t newMiss        = (m + missed) * (counted ^ 1);
+        uint32_t newCounter     = c + counted;
+        const uint32_t lost     = missed & (newMiss > missFrames);
+        const uint32_t hitNow   = (wasDone ^ 1) & ((newCounter * (lost ^ 1)) >= okayFrames);
+        const uint32_t clear    = (lost | hitNow) ^ 1;
+        newMiss                *= clear;
+        newCounter             *= clear;
+        const uint32_t newDone  = hitNow | (wasDone & (lost ^ 1));
+
+        /* blend by multiplication, isOn is 0 or 1 */
+        counter[s]  = c + (newCounter - c) * isOn;
+        miss[s]     = m + (newMiss - m) * isOn;
+        done[s]     = wasDone + (newDone - wasDone) * isOn;
+        hit[s]      = hitNow & isOn;
+        onset[s]    = counted & (c == 0) & isOn;
+        nDetected  += hitNow & isOn;
+    }
+    return nDetected;
+}
+
+int DetectorBank::update()
+{
+    const uint32_t nDetected = updateStreams(streams, threshold, okayFrames, missFrames,
+                                             peaks.data(), means.data(), deviations.data(), active.data(),
+                                             whistleCounter.data(), whistleMissCounter.data(), whistleDone.data(),
+                                             detected.data(), started.data());
+
+    /* 64 bit frame counters do not vectorize well on 32 bit targets, keep them apart */
+    for(int s = 0; s < streams; ++s) {
+        onsetFrames[s]  = started[s] ? frames[s] : onsetFrames[s];
+        frames[s]      += active[s];
+    }
+    return static_cast<int>(nDetected);
+}
@@ -0,0 +1,50 @@
+/*!
+ * \brief The whistle decision of Detector for many independent streams at once, the state is
+ *        stored as structure of arrays so one frame of all streams is a vectorizable loop.
+ */
+
+#ifndef __AK_DETECTOR_BANK__
+#define __AK_DETECTOR_BANK__
+
+#include <cstdint>
+#include <vector>
+
+class DetectorBank
+{
+public:
+    /* threshold: multiples of the deviation above the mean, see Detector */
+    DetectorBank(int streams, float threshold, unsigned okayFrames, unsigned missFrames);
+
+    /* inputs of the next frame, one value per stream: peak magnitude of the whistle band,
+     * mean and deviation of the spectrum and whether the stream has a frame at all */
+    float *getPeaks() { return peaks.data(); }
+    float *getMeans() { return means.data(); }
+    float *getDeviations() { return deviations.data(); }
+    uint32_t *getActive() { return active.data(); }
+
+    /* advances all active streams by one frame, returns the number of streams that just
+     * detected a whistle, they are flagged in getDetected() */
+    int update();
+
+    const uint32_t *getDetected() const { return detected.data(); }
+    /* frames seen and first whistle frame of the last detection per stream */
+    uint64_t getFrame(int stream) const { return frames[stream]; }
+    uint64_t getOnsetFrame(int stream) const { return onsetFrames[stream]; }
+
+    int getStreams() const { return streams; }
+    void reset();
+
+protected:
+    const int streams;
+    const float threshold;
+    const uint32_t okayFrames, missFrames;
+
+    std::vector<float> peaks, means, deviations;
+    std::vector<uint32_t> active;
+
+    std::vector<uint32_t> whistleCounter, whistleMissCounter, whistleDone;
+    std::vector<uint32_t> detected, started;
+    std::vector<uint64_t> frames, onsetFrames;
+};
+
+#endif
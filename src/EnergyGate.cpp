@@ -0,0 +1,108 @@
+/*!
+ * \brief Cheap time domain gate in front of the transforms: a band-pass around the whistle band
+ *        and its energy against a tracked floor decide whether a buffer needs a spectrum at all.
+ */
+
+#include "EnergyGate.h"
+#include <algorithm>
+#include <cmath>
+
+#define MIN_FLOOR       (1.0f)      /* mean square, about one LSB */
+#define MIN_BANDWIDTH   (100.0f)    /* Hz, a single tone band still passes a swept whistle */
+#define FALL_SPEEDUP    (8.0f)      /* the floor falls faster than it rises, so a loud whistle is forgotten soon */
+#define SMOOTHING_TIME  (0.02)      /* s, the energy of short buffers fluctuates with the syllables of a crowd */
+
+EnergyGate::EnergyGate(int sampleRate, float fBegin, float fEnd, float threshold, int holdFrames, int adaptationFrames)
+    : x1(0.0f), x2(0.0f), y1(0.0f), y2(0.0f),
+      smoothing(static_cast<float>(1.0 - std::exp(-1.0 / (SMOOTHING_TIME * sampleRate)))), energy(0.0f),
+      ratio(std::pow(10.0f, threshold / 10.0f)), holdFrames(holdFrames),
+      adaptationFrames(static_cast<float>(std::max(1, adaptationFrames))),
+      open(true), learnedFrames(0), floorEnergy(MIN_FLOOR), hold(holdFrames), aboveFrames(0),
+      openBuffers(0), buffers(0)
+{
+    const double center = std::sqrt(std::max(1.0, static_cast<double>(fBegin)) * fEnd);
+    const double bandwidth = std::max(MIN_BANDWIDTH, fEnd - fBegin);
+    const double w0 = 2.0 * M_PI * center / sampleRate;
+    const double alpha = std::sin(w0) * bandwidth / (2.0 * center);
+    const double a0 = 1.0 + alpha;
+    b0 = static_cast<float>(alpha / a0);
+    b2 = static_cast<float>(-alpha / a0);
+    a1 = static_cast<float>(-2.0 * std::cos(w0) / a0);
+    a2 = static_cast<float>((1.0 - alpha) / a0);
+}
+
+void EnergyGate::reset()
+{
+    x1 = x2 = y1 = y2 = 0.0f;
+    energy = 0.0f;
+    open = true;
+    learnedFrames = 0;
+    floorEnergy = MIN_FLOOR;
+    hold = holdFrames;
+    aboveFrames = 0;
+}
+
+void EnergyGate::continueFrom(const EnergyGate &previous)
+{
+    x1 = previous.x1;
+    x2 = previous.x2;
+    y1 = previous.y1;
+    y2 = previous.y2;
+    energy = previous.energy;
+    open = previous.open;
+    learnedFrames = previous.learnedFrames;
+    floorEnergy = previous.floorEnergy;
+    hold = previous.hold;
+    aboveFrames = previous.aboveFrames;
+}
+
+bool EnergyGate::update(const int16_t *data, int length, short channels)
+{
+    if(length <= 0) {
+        return open;
+    }
+
+    /* b1 of the band-pass is zero, the squared output is smoothed by a one-pole low-pass */
+    float e = energy;
+    for(int i = 0; i < length; ++i) {
+        const float x = data[i * channels];
+        const float y = b0 * x + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        e += smoothing * (y * y - e);
+    }
+    energy = e;
+
+    const float alpha = std::min(1.0f, length / adaptationFrames);
+    /* the floor starts as the mean over the first hold, the gate is open meanwhile */
+    if(learnedFrames < holdFrames) {
+        learnedFrames += length;
+        floorEnergy = std::max(MIN_FLOOR, floorEnergy + static_cast<float>(length) / learnedFrames * (energy - floorEnergy));
+        hold -= length;
+        open = true;
+    } else if(energy > ratio * floorEnergy) {
+        /* a whistle does not raise the floor, a louder background does after a while */
+        aboveFrames += length;
+        if(aboveFrames > adaptationFrames) {
+            floorEnergy += alpha * (energy - floorEnergy);
+        }
+        open = true;
+        hold = holdFrames;
+    } else {
+        aboveFrames = 0;
+        const float rate = energy < floorEnergy ? std::min(1.0f, FALL_SPEEDUP * alpha) : alpha;
+        floorEnergy = std::max(MIN_FLOOR, floorEnergy + rate * (energy - floorEnergy));
+        if(open) {
+            hold -= length;
+            open = hold > 0;
+        }
+    }
+
+    ++buffers;
+    if(open) {
+        ++openBuffers;
+    }
+    return open;
+}
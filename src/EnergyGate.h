@@ -0,0 +1,49 @@
+/*!
+ * \brief Cheap time domain gate in front of the transforms: a band-pass around the whistle band
+ *        and its energy against a tracked floor decide whether a buffer needs a spectrum at all.
+ */
+
+#ifndef __AK_ENERGY_GATE__
+#define __AK_ENERGY_GATE__
+
+#include <cstdint>
+
+class EnergyGate
+{
+public:
+    /* band in Hz, threshold: in band energy above the floor to open in dB, holdFrames: frames
+     * the gate stays open after the energy dropped, adaptation: time constant of the floor in frames */
+    EnergyGate(int sampleRate, float fBegin, float fEnd, float threshold, int holdFrames, int adaptationFrames);
+
+    /* filters channel 0 of a buffer, returns true if the buffer has to be transformed */
+    bool update(const int16_t *data, int length, short channels);
+    /* open again, the floor is learned again from the next buffers */
+    void reset();
+    /* keeps the floor and the state of the gate before a reload */
+    void continueFrom(const EnergyGate &previous);
+
+    bool isOpen() const { return open; }
+    /* buffers let through and buffers in total, for the statistics */
+    uint64_t getOpenBuffers() const { return openBuffers; }
+    uint64_t getBuffers() const { return buffers; }
+
+protected:
+    /* biquad, RBJ band-pass with 0 dB peak gain */
+    float b0, b2, a1, a2;
+    float x1, x2, y1, y2;
+    const float smoothing;
+    float energy;   /* smoothed mean square of the band */
+
+    const float ratio;
+    const int holdFrames;
+    const float adaptationFrames;
+
+    bool open;
+    int learnedFrames;
+    float floorEnergy;
+    int hold;       /* frames left until the gate closes */
+    int aboveFrames;
+    uint64_t openBuffers, buffers;
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*!
+ * \brief Hands whistle events from the audio thread to a dispatcher thread, so a slow handler
+ *        (IPC into ALMemory) never stalls the capture.
+ */
+
+#include "EventDispatcher.h"
+#include <pthread.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+EventDispatcher::EventDispatcher(WhistleHandler handler, int capacity, uint64_t coalesceTime)
+    : handler(handler), coalesceTime(coalesceTime), queue(capacity > 0 ? capacity : 1), running(false),
+      dispatched(0), dropped(0)
+{
+    sem_init(&semaphore, 0, 0);
+}
+
+EventDispatcher::~EventDispatcher()
+{
+    stop();
+    sem_destroy(&semaphore);
+}
+
+bool EventDispatcher::start()
+{
+    if(running) {
+        std::cerr << "Double initialization" << std::endl;
+        return false;
+    }
+    running = true;
+    thread = std::thread(&EventDispatcher::main, this);
+    pthread_setname_np(thread.native_handle(), "WhistleEvents");
+    return true;
+}
+
+void EventDispatcher::stop()
+{
+    if(!thread.joinable()) {
+        return;
+    }
+    running = false;
+    sem_post(&semaphore);
+    thread.join();
+}
+
+bool EventDispatcher::post(const WhistleEvent &event)
+{
+    if(!queue.write(&event, 1)) {
+        /* the handler is behind, never wait for it */
+        ++dropped;
+        return false;
+    }
+    sem_post(&semaphore);
+    return true;
+}
+
+void EventDispatcher::main()
+{
+    while(true) {
+        while(sem_wait(&semaphore) < 0 && errno == EINTR) {
+        }
+        const bool last = !running;
+
+        /* a burst of one profile queued while the handler was busy goes out as one event per coalesceTime */
+        size_t n;
+        const WhistleEvent *events = queue.peek(n);
+        while(n > 0) {
+            WhistleEvent event = events[0];
+            size_t used = 1;
+            for(; used < n && events[used].position - event.position < coalesceTime
+                  && strcmp(events[used].profile, event.profile) == 0; ++used) {
+                event.confidence = std::max(event.confidence, events[used].confidence);
+                event.count += events[used].count;
+            }
+            queue.consume(used);
+
+            handler(event);
+            ++dispatched;
+            events = queue.peek(n);
+        }
+
+        if(last) {
+            break;
+        }
+    }
+}
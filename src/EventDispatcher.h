@@ -0,0 +1,59 @@
+/*!
+ * \brief Hands whistle events from the audio thread to a dispatcher thread, so a slow handler
+ *        (IPC into ALMemory) never stalls the capture.
+ */
+
+#ifndef __AK_EVENT_DISPATCHER__
+#define __AK_EVENT_DISPATCHER__
+
+#include "RingBuffer.h"
+#include <semaphore.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+struct WhistleEvent
+{
+    uint64_t detected;      /* CLOCK_MONOTONIC in ns when the whistle was detected */
+    uint64_t onset;         /* capture time of the onset window in ns, 0: unknown (timing off) */
+    uint64_t position;      /* onset in ns of audio since listening started (replays run faster) */
+    float confidence;       /* share of the frames since the onset with the band standing out, 0 - 1 */
+    unsigned count;         /* detections coalesced into this event */
+    char profile[32];       /* [Whistle.<profile>] that was heard, empty: [Whistle] */
+};
+
+typedef std::function<void (const WhistleEvent &event)> WhistleHandler;
+
+class EventDispatcher
+{
+public:
+    /* capacity: events queued at most, coalesceTime: detections of one profile queued while the
+     * handler was busy and closer than this (in ns of audio) to the first one of them are one event */
+    EventDispatcher(WhistleHandler handler, int capacity, uint64_t coalesceTime);
+    ~EventDispatcher();
+
+    bool start();
+    /* dispatches what is queued, then joins the thread */
+    void stop();
+
+    /* audio thread, never blocks: false if the queue is full and the event was dropped */
+    bool post(const WhistleEvent &event);
+
+    unsigned long getDispatched() const { return dispatched; }
+    unsigned long getDropped() const { return dropped; }
+
+protected:
+    void main();
+
+    WhistleHandler handler;
+    const uint64_t coalesceTime;
+
+    RingBuffer<WhistleEvent> queue;
+    sem_t semaphore;
+    std::atomic<bool> running;
+    std::thread thread;
+    std::atomic<unsigned long> dispatched, dropped;
+};
+
+#endif
@@ -0,0 +1,198 @@
+/*!
+ * \brief Replays recorded sound data (WAV or raw S16) from a memory mapped file.
+ */
+
+#include "FileSource.h"
+#include "Timing.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#define WAV_FORMAT_PCM          (0x0001)
+#define WAV_FORMAT_EXTENSIBLE   (0xFFFE)
+
+static uint16_t readLE16(const uint8_t *p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t readLE32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+FileSource::FileSource(Handler handler, const std::string &path, int framesPerBuffer,
+                       short rawChannels, int rawSampleRate)
+    : AudioSource(handler), path(path), framesPerBuffer(framesPerBuffer),
+      channels(rawChannels), sampleRate(rawSampleRate),
+      fd(-1), mapping(NULL), mappingSize(0), samples(NULL), nFrames(0)
+{
+}
+
+FileSource::~FileSource()
+{
+    closeFile();
+}
+
+void FileSource::main()
+{
+    if(!openFile()) {
+        return;
+    }
+
+    running = true;
+
+    const auto start = std::chrono::steady_clock::now();
+    long iFrame = 0;
+    while(running && iFrame < nFrames) {
+        waitWhilePaused();
+
+        int count = framesPerBuffer;
+        if(iFrame + count > nFrames) {
+            count = static_cast<int>(nFrames - iFrame);
+        }
+
+        /* a buffer counts as captured when it is handed over, the latency is the processing time */
+        iFrame += count;
+        if(Timing::isAnchoring()) {
+            Timing::setCaptureAnchor(iFrame, Timing::now(), sampleRate);
+        }
+
+        /* process directly from the mapping */
+        StageTimer timer(TIMING_BUFFER);
+        deliver(samples + (iFrame - count) * channels, count, channels);
+    }
+    const auto stop = std::chrono::steady_clock::now();
+
+    const double elapsed = std::chrono::duration<double>(stop - start).count();
+    const double duration = static_cast<double>(iFrame) / sampleRate;
+    std::cout << "Replayed " << iFrame << " frames (" << duration << " s of audio) in "
+              << elapsed << " s";
+    if(elapsed > 0) {
+        std::cout << ", " << (duration / elapsed) << "x real time, "
+                  << (iFrame / elapsed) << " frames/s";
+    }
+    std::cout << "." << std::endl;
+
+    running = false;
+    closeFile();
+}
+
+/*******************************************************************/
+bool FileSource::openFile()
+{
+    if(mapping) {
+        std::cerr << "Double initialization" << std::endl;
+        return false;
+    }
+
+    fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cerr << "cannot open sound file " << path << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size <= 0) {
+        std::cerr << "cannot stat sound file " << path << std::endl;
+        closeFile();
+        return false;
+    }
+    mappingSize = static_cast<size_t>(st.st_size);
+
+    void *addr = mmap(NULL, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(addr == MAP_FAILED) {
+        std::cerr << "cannot map sound file " << path << " (" << strerror(errno) << ")" << std::endl;
+        mappingSize = 0;
+        closeFile();
+        return false;
+    }
+    mapping = static_cast<const uint8_t*>(addr);
+    madvise(addr, mappingSize, MADV_SEQUENTIAL);
+
+    if(mappingSize >= 12 && memcmp(mapping, "RIFF", 4) == 0 && memcmp(mapping + 8, "WAVE", 4) == 0) {
+        if(!parseWav()) {
+            closeFile();
+            return false;
+        }
+    } else {
+        /* raw interleaved S16 */
+        samples = reinterpret_cast<const int16_t*>(mapping);
+        nFrames = static_cast<long>(mappingSize / (sizeof(int16_t) * channels));
+    }
+
+    std::cout << "Replaying " << path << ": " << channels << " channel(s), " << sampleRate << " Hz, "
+              << nFrames << " frames." << std::endl;
+    return true;
+}
+
+bool FileSource::parseWav()
+{
+    bool haveFormat = false;
+    size_t pos = 12;
+
+    while(pos + 8 <= mappingSize) {
+        const uint8_t *chunk = mapping + pos;
+        size_t chunkSize = readLE32(chunk + 4);
+        pos += 8;
+
+        if(memcmp(chunk, "fmt ", 4) == 0) {
+            if(chunkSize < 16 || pos + 16 > mappingSize) {
+                std::cerr << "truncated WAV format chunk in " << path << std::endl;
+                return false;
+            }
+            const uint16_t format = readLE16(mapping + pos);
+            const uint16_t bits   = readLE16(mapping + pos + 14);
+            if((format != WAV_FORMAT_PCM && format != WAV_FORMAT_EXTENSIBLE) || bits != 16) {
+                std::cerr << "only 16 bit PCM WAV files are supported (" << path << ")" << std::endl;
+                return false;
+            }
+            const int fileSampleRate = static_cast<int>(readLE32(mapping + pos + 4));
+            if(fileSampleRate != sampleRate) {
+                std::cerr << "Warning: " << path << " is sampled at " << fileSampleRate
+                          << " Hz, configured are " << sampleRate << " Hz" << std::endl;
+            }
+            channels   = static_cast<short>(readLE16(mapping + pos + 2));
+            sampleRate = fileSampleRate;
+            haveFormat = true;
+        } else if(memcmp(chunk, "data", 4) == 0) {
+            if(!haveFormat || channels <= 0) {
+                std::cerr << "WAV data chunk before format chunk in " << path << std::endl;
+                return false;
+            }
+            if(pos + chunkSize > mappingSize) {
+                /* recorders that were killed leave a bogus size behind */
+                chunkSize = mappingSize - pos;
+            }
+            samples = reinterpret_cast<const int16_t*>(mapping + pos);
+            nFrames = static_cast<long>(chunkSize / (sizeof(int16_t) * channels));
+            return true;
+        }
+
+        /* chunks are word aligned */
+        pos += chunkSize + (chunkSize & 1);
+    }
+
+    std::cerr << "no data chunk found in " << path << std::endl;
+    return false;
+}
+
+void FileSource::closeFile()
+{
+    if(mapping) {
+        munmap(const_cast<uint8_t*>(mapping), mappingSize);
+        mapping = NULL;
+        mappingSize = 0;
+    }
+    if(fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    samples = NULL;
+    nFrames = 0;
+}
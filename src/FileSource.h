@@ -0,0 +1,48 @@
+/*!
+ * \brief Replays recorded sound data (WAV or raw S16) from a memory mapped file.
+ */
+
+#ifndef __AK_FILE_SOURCE__
+#define __AK_FILE_SOURCE__
+
+#include "AudioSource.h"
+#include <string>
+
+class FileSource : public AudioSource
+{
+public:
+    /* raw files carry no header, rawChannels and rawSampleRate describe them */
+    FileSource(Handler handler, const std::string &path, int framesPerBuffer,
+               short rawChannels, int rawSampleRate);
+    virtual ~FileSource();
+
+    virtual void main();
+
+    /* maps the file without replaying it, the samples are valid until closeFile() */
+    bool openFile();
+    void closeFile();
+
+    const std::string &getPath() const { return path; }
+    short getChannels() const { return channels; }
+    int getSampleRate() const { return sampleRate; }
+    const int16_t *getSamples() const { return samples; }
+    long getFrames() const { return nFrames; }
+
+protected:
+    bool parseWav();
+
+    const std::string path;
+    const int framesPerBuffer;
+
+    short channels;
+    int sampleRate;
+
+    int fd;
+    const uint8_t *mapping;
+    size_t mappingSize;
+
+    const int16_t *samples;
+    long nFrames;
+};
+
+#endif
@@ -0,0 +1,202 @@
+/*!
+ * \brief Real FFT in Q15 fixed point for targets without a fast FPU: a half size complex
+ *        Stockham transform of radix 4, 2, 3 and 5 stages with block floating point scaling.
+ */
+
+#include "FixedFFT.h"
+#include "Kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/* growth of the largest component through a radix R butterfly, R * sqrt(2) * 1024 */
+static int stageGain(int radix)
+{
+    switch(radix) {
+    case 2:  return 2897;
+    case 3:  return 4345;
+    case 4:  return 5793;
+    default: return 7241;
+    }
+}
+
+/* symmetric, so that the negated sines still fit */
+static int16_t toQ15(double x)
+{
+    return static_cast<int16_t>(std::max(-32767L, std::min(32767L, std::lround(x * 32768.0))));
+}
+
+bool FixedFFT::isSupported(int size)
+{
+    if(size < 4 || (size & 1)) {
+        return false;
+    }
+    int m = size / 2;
+    const int factors[] = {2, 3, 5};
+    for(int i = 0; i < 3; ++i) {
+        while(m % factors[i] == 0) {
+            m /= factors[i];
+        }
+    }
+    return m == 1;
+}
+
+FixedFFT::FixedFFT(const int size)
+    : size(size), half(size / 2), rotated(size)
+{
+    buffers[0].resize(size);
+    buffers[1].resize(size);
+
+    /* radix 4 first, it has the fewest multiplications per point */
+    std::vector<int> radices;
+    int m = half;
+    const int factors[] = {4, 2, 3, 5};
+    for(int i = 0; i < 4; ++i) {
+        while(m % factors[i] == 0) {
+            radices.push_back(factors[i]);
+            m /= factors[i];
+        }
+    }
+
+    int span = 1;
+    for(size_t i = 0; i < radices.size(); ++i) {
+        Stage stage;
+        stage.radix = radices[i];
+        stage.span = span;
+        const int length = half / stage.radix;
+        if(span > 1) {
+            stage.cosines.resize(2 * length * stage.radix);
+            stage.sines.resize(2 * length * stage.radix);
+            for(int r = 1; r < stage.radix; ++r) {
+                for(int j = 0; j < length; ++j) {
+                    const double angle = -2.0 * M_PI * r * (j % span) / (span * stage.radix);
+                    const int16_t c = toQ15(std::cos(angle)), s = toQ15(std::sin(angle));
+                    int16_t *cosine = &stage.cosines[2 * (r * length + j)];
+                    int16_t *sine = &stage.sines[2 * (r * length + j)];
+                    cosine[0] = c;
+                    cosine[1] = c;
+                    sine[0] = static_cast<int16_t>(-s);
+                    sine[1] = s;
+                }
+            }
+        }
+        stages.push_back(stage);
+        span *= stage.radix;
+    }
+
+    postCosines.resize(half + 1);
+    postSines.resize(half + 1);
+    for(int k = 0; k <= half; ++k) {
+        postCosines[k] = static_cast<int32_t>(std::lround(32768.0 * std::cos(-2.0 * M_PI * k / size)));
+        postSines[k] = static_cast<int32_t>(std::lround(32768.0 * std::sin(-2.0 * M_PI * k / size)));
+    }
+}
+
+int FixedFFT::runStages(int16_t *&current, int16_t *&next)
+{
+    int shifted = 0;
+    const int16_t *in[5];
+    int16_t *out[5];
+
+    for(size_t i = 0; i < stages.size(); ++i) {
+        const Stage &stage = stages[i];
+        const int radix = stage.radix, span = stage.span;
+        const int length = half / radix;
+
+        /* just enough headroom that the butterflies never saturate */
+        const int largest = q15MaxAbs(current, half);
+        const int gain = stageGain(radix);
+        int shift = 0;
+        while(shift < 15 && (((largest + ((1 << shift) >> 1)) >> shift) + 2) * gain > 32767 * 1024) {
+            ++shift;
+        }
+        shifted += shift;
+
+        /* input r of butterfly j is current[j + r * length], rotated by its twiddle */
+        for(int r = 0; r < radix; ++r) {
+            const int16_t *source = current + 2 * r * length;
+            int16_t *target = &rotated[2 * r * length];
+            if(r == 0 || span == 1) {
+                q15Scale(source, target, length, shift);
+            } else {
+                q15Rotate(source, &stage.cosines[2 * r * length], &stage.sines[2 * r * length], target, length, shift);
+            }
+            in[r] = target;
+        }
+
+        if(span == 1) {
+            /* outputs of butterfly j go to next[j * radix + r], through the free current buffer */
+            for(int r = 0; r < radix; ++r) {
+                out[r] = current + 2 * r * length;
+            }
+            q15Butterfly(radix, in, out, length);
+            for(int j = 0; j < length; ++j) {
+                for(int r = 0; r < radix; ++r) {
+                    next[2 * (j * radix + r)]     = out[r][2 * j];
+                    next[2 * (j * radix + r) + 1] = out[r][2 * j + 1];
+                }
+            }
+        } else {
+            /* span consecutive butterflies write span consecutive outputs per r */
+            for(int block = 0; block < length; block += span) {
+                for(int r = 0; r < radix; ++r) {
+                    in[r] = &rotated[2 * (r * length + block)];
+                    out[r] = next + 2 * (block * radix + r * span);
+                }
+                q15Butterfly(radix, in, out, span);
+            }
+        }
+        std::swap(current, next);
+    }
+    return shifted;
+}
+
+void FixedFFT::postProcess(const int16_t *z, int exponent, uint32_t *magnitudes)
+{
+    /* X[k] = (E + W^k * -i D) / 2 with E = Z[k] + conj(Z[half - k]) and D = Z[k] - conj(Z[half - k]),
+     * kept with 8 bits below the Q15 integer part */
+    for(int k = 0; k <= half; ++k) {
+        const int a = k % half, b = (half - k) % half;
+        const int64_t eRe = z[2 * a] + z[2 * b], eIm = z[2 * a + 1] - z[2 * b + 1];
+        const int64_t dRe = z[2 * a] - z[2 * b], dIm = z[2 * a + 1] + z[2 * b + 1];
+        const int64_t oRe = dIm, oIm = -dRe;
+        const int64_t c = postCosines[k], s = postSines[k];
+        const int64_t re = (eRe * 32768 + c * oRe - s * oIm + 64) >> 7;
+        const int64_t im = (eIm * 32768 + c * oIm + s * oRe + 64) >> 7;
+        const uint64_t magnitude = integerSqrt(static_cast<uint64_t>(re * re + im * im));
+
+        /* 2 |X| with 8 fraction bits, times the block exponent */
+        const int bits = exponent - 9;
+        magnitudes[k] = static_cast<uint32_t>(bits >= 0 ? magnitude << bits
+                                              : (magnitude + ((1ull << -bits) >> 1)) >> -bits);
+    }
+}
+
+void FixedFFT::transform(const int16_t *samples, int length, uint32_t *magnitudes)
+{
+    /* the real samples are the real and imaginary parts of a half size complex sequence */
+    int16_t *current = &buffers[0][0], *next = &buffers[1][0];
+    length = std::min(length, size);
+    memcpy(current, samples, length * sizeof(int16_t));
+    memset(current + length, 0, (size - length) * sizeof(int16_t));
+
+    const int largest = q15MaxAbs(current, half);
+    if(largest == 0) {
+        memset(magnitudes, 0, (half + 1) * sizeof(uint32_t));
+        return;
+    }
+    /* quiet windows use the full 16 bits */
+    int normalize = 0;
+    while((largest << (normalize + 1)) <= 32767) {
+        ++normalize;
+    }
+    if(normalize > 0) {
+        for(int i = 0; i < length; ++i) {
+            current[i] = static_cast<int16_t>(current[i] * (1 << normalize));
+        }
+    }
+
+    const int shifted = runStages(current, next);
+    postProcess(current, shifted - normalize, magnitudes);
+}
@@ -0,0 +1,45 @@
+/*!
+ * \brief Real FFT in Q15 fixed point for targets without a fast FPU: a half size complex
+ *        Stockham transform of radix 4, 2, 3 and 5 stages with block floating point scaling.
+ */
+
+#ifndef __AK_FIXED_FFT__
+#define __AK_FIXED_FFT__
+
+#include <cstdint>
+#include <vector>
+
+class FixedFFT
+{
+public:
+    /* size: points of the (zero padded) real transform, see isSupported */
+    explicit FixedFFT(const int size);
+
+    /* even and half of it a product of 2, 3 and 5 */
+    static bool isSupported(int size);
+
+    /* magnitudes of the bins 0 .. size / 2 of the length samples padded with zeros, in units of
+     * the input: |DFT| rounded, the same scale as the float STFT times 32768 */
+    void transform(const int16_t *samples, int length, uint32_t *magnitudes);
+
+    int getSize() const { return size; }
+    int getBins() const { return half + 1; }
+
+protected:
+    struct Stage {
+        int radix, span;                /* span: length of the sub transforms already done */
+        std::vector<int16_t> cosines;   /* (c, c) per input j of every r > 0, see q15Rotate */
+        std::vector<int16_t> sines;     /* (-s, s) */
+    };
+
+    /* returns the bits shifted out on the way, the result is in current */
+    int runStages(int16_t *&current, int16_t *&next);
+    void postProcess(const int16_t *z, int exponent, uint32_t *magnitudes);
+
+    const int size, half;
+    std::vector<Stage> stages;
+    std::vector<int16_t> buffers[2], rotated;
+    std::vector<int32_t> postCosines, postSines;    /* exp(-2 pi i k / size) in Q15, k <= half */
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*!
+ * \brief Short Time Fourier Transform in fixed point: int16 windows through the Q15 FFT to
+ *        integer magnitudes, no float on the way.
+ */
+
+#include "FixedSTFT.h"
+#include "Timing.h"
+
+FixedSTFT::FixedSTFT(const int channelOffset, const int windowTime, const int windowTimeStep, const int windowFrequency,
+                     std::function<void (const uint32_t *spectrum, int length)> handleSpectrum)
+    : SlidingWindow(channelOffset, windowTime, windowTimeStep),
+      fft(windowFrequency), handleSpectrum(handleSpectrum),
+      input(windowTime), outputMag(fft.getBins())
+{
+}
+
+FixedSTFT::~FixedSTFT()
+{
+}
+
+void FixedSTFT::transform()
+{
+    /* the magnitudes come out of the post processing of the half size transform */
+    {
+        StageTimer timer(TIMING_FFT);
+        fft.transform(&input[0], windowTime, &outputMag[0]);
+    }
+
+    StageTimer timer(TIMING_SPECTRUM);
+    handleSpectrum(&outputMag[0], fft.getBins());
+}
+
+void FixedSTFT::newData(const int16_t *data, int length, short channels)
+{
+    skipData(data, length, channels);
+
+    const int total = streamLength(length);
+    int iBegin = 0;
+    while(iBegin + windowTime <= total) {
+        {
+            StageTimer timer(TIMING_CONVERT);
+            fillWindowInt16(&input[0], data, iBegin, channels);
+        }
+        transform();
+        iBegin += windowTimeStep;
+    }
+
+    keepOverflow(data, length, iBegin, channels);
+}
@@ -0,0 +1,35 @@
+/*!
+ * \brief Short Time Fourier Transform in fixed point: int16 windows through the Q15 FFT to
+ *        integer magnitudes, no float on the way.
+ */
+
+#ifndef __AK_FIXED_STFT__
+#define __AK_FIXED_STFT__
+
+#include "FixedFFT.h"
+#include "SlidingWindow.h"
+#include <functional>
+#include <vector>
+
+class FixedSTFT : public SlidingWindow
+{
+public:
+    /* windowFrequency: see FixedFFT::isSupported, handler: magnitudes of the bins 0 .. windowFrequency / 2
+     * in input units (the float STFT times 32768) */
+    FixedSTFT(const int channelOffset, const int windowTime, const int windowTimeStep, const int windowFrequency,
+              std::function<void (const uint32_t *spectrum, int length)> handleSpectrum);
+    virtual ~FixedSTFT();
+
+    void newData(const int16_t *data, int length, short channels);
+
+protected:
+    void transform();
+
+    FixedFFT fft;
+    std::function<void (const uint32_t *spectrum, int length)> handleSpectrum;
+
+    std::vector<int16_t> input;
+    std::vector<uint32_t> outputMag;
+};
+
+#endif
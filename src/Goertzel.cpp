@@ -0,0 +1,87 @@
+/*!
+ * \brief Band limited spectral analysis: Goertzel filters for a few bins of a (padded) DFT
+ *        and the spectrum statistics estimated from the window energy instead of a full FFT.
+ */
+
+#include "Goertzel.h"
+#include "Timing.h"
+#include <algorithm>
+#include <cmath>
+
+Goertzel::Goertzel(const int channelOffset, const int windowTime, const int windowTimeStep, const int windowFrequency,
+                   const int binBegin, const int binEnd,
+                   std::function<void (const float *band, int length, float mean, float dev)> handleBand)
+    : SlidingWindow(channelOffset, windowTime, windowTimeStep),
+      windowFrequency(windowFrequency), windowFrequencyHalf(windowFrequency / 2 + 1),
+      binBegin(binBegin), binEnd(binEnd), handleBand(handleBand),
+      input(windowTime), coefficients(binEnd > binBegin ? binEnd - binBegin : 0), bandMag(coefficients.size())
+{
+    for(size_t i = 0; i < coefficients.size(); ++i) {
+        coefficients[i] = 2.0f * std::cos(2.0 * M_PI * (binBegin + i) / windowFrequency);
+    }
+}
+
+Goertzel::~Goertzel()
+{
+}
+
+void Goertzel::transform()
+{
+    /* the padding is zero, only the real window contributes to any bin */
+    {
+        StageTimer timer(TIMING_FFT);
+        for(size_t k = 0; k < coefficients.size(); ++k) {
+            const float c = coefficients[k];
+            float s1 = 0.0f, s2 = 0.0f;
+            for(int i = 0; i < windowTime; ++i) {
+                const float s0 = input[i] + c * s1 - s2;
+                s2 = s1;
+                s1 = s0;
+            }
+            bandMag[k] = std::sqrt(std::max(0.0f, s1 * s1 + s2 * s2 - c * s1 * s2));
+        }
+    }
+
+    /* Parseval: sum of |X|^2 over all windowFrequency bins is windowFrequency * energy, the
+     * half spectrum holds half of it plus the unmirrored bins 0 and windowFrequency / 2 */
+    double energy = 0.0, dc = 0.0, nyquist = 0.0;
+    for(int i = 0; i < windowTime; ++i) {
+        energy  += input[i] * input[i];
+        dc      += input[i];
+        nyquist += (i & 1) ? -input[i] : input[i];
+    }
+    double power = windowFrequency * energy + dc * dc;
+    if((windowFrequency & 1) == 0) {
+        power += nyquist * nyquist;
+    }
+    power /= 2.0 * windowFrequencyHalf;
+
+    /* the mean magnitude is not known, assume Rayleigh distributed noise:
+     * E|X| = sqrt(pi / 4 * E|X|^2), Var|X| = (1 - pi / 4) * E|X|^2 */
+    const float mean = std::sqrt(M_PI / 4.0 * power);
+    const float dev  = std::sqrt((1.0 - M_PI / 4.0) * power);
+
+    StageTimer timer(TIMING_SPECTRUM);
+    handleBand(bandMag.data(), static_cast<int>(bandMag.size()), mean, dev);
+}
+
+void Goertzel::newData(const int16_t *data, int length, short channels)
+{
+    skipData(data, length, channels);
+
+    const int total = streamLength(length);
+    int iBegin = 0;
+
+    while(iBegin + windowTime <= total) {
+        {
+            StageTimer timer(TIMING_CONVERT);
+            fillWindow(input.data(), data, iBegin, channels);
+        }
+        transform();
+
+        /* next cycle */
+        iBegin += windowTimeStep;
+    }
+
+    keepOverflow(data, length, iBegin, channels);
+}
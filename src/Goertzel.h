@@ -0,0 +1,37 @@
+/*!
+ * \brief Band limited spectral analysis: Goertzel filters for a few bins of a (padded) DFT
+ *        and the spectrum statistics estimated from the window energy instead of a full FFT.
+ */
+
+#ifndef __AK_GOERTZEL__
+#define __AK_GOERTZEL__
+
+#include "SlidingWindow.h"
+#include <functional>
+#include <vector>
+
+class Goertzel : public SlidingWindow
+{
+public:
+    /* computes the magnitudes of bins [binBegin, binEnd) of a windowFrequency point DFT,
+     * handler: band magnitudes, number of bins, estimated mean and deviation of the spectrum */
+    Goertzel(const int channelOffset, const int windowTime, const int windowTimeStep, const int windowFrequency,
+             const int binBegin, const int binEnd,
+             std::function<void (const float *band, int length, float mean, float dev)> handleBand);
+    virtual ~Goertzel();
+
+    void newData(const int16_t *data, int length, short channels);
+
+protected:
+    void transform();
+
+    const int windowFrequency, windowFrequencyHalf;
+    const int binBegin, binEnd;
+    std::function<void (const float *band, int length, float mean, float dev)> handleBand;
+
+    std::vector<float> input;
+    std::vector<float> coefficients;
+    std::vector<float> bandMag;
+};
+
+#endif
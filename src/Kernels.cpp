@@ -0,0 +1,898 @@
+/*!
+ * \brief Vectorized inner loops (SSE2, SSSE3, AVX2, NEON) with scalar fallback, selected at runtime.
+ */
+
+#include "Kernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__i386__) || defined(__x86_64__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+#define INT16_SCALE     (1.0f / 32768.0f)
+
+/* Q15 constants of the radix 3 and 5 butterflies */
+#define Q15_HALF        (16384)
+#define Q15_SIN60       (28378)     /* sin(2 pi / 3) */
+#define Q15_COS72       (10126)     /* cos(2 pi / 5) */
+#define Q15_COS144      (-26510)    /* cos(4 pi / 5) */
+#define Q15_SIN72       (31164)
+#define Q15_SIN144      (19261)
+
+struct KernelTable {
+    const char *name;
+    void (*convertInt16)(const int16_t *in, int stride, float *out, int n);
+    void (*deinterleaveInt16)(const int16_t *in, int stride, float *const *out, int channels, int n);
+    void (*complexMagnitude)(const float *in, float *out, int n);
+    void (*meanDeviation)(const float *data, int n, double &sum, double &sumSquared);
+    float (*dotProduct)(const float *a, const float *b, int n);
+    int (*q15MaxAbs)(const int16_t *data, int n);
+    void (*q15Scale)(const int16_t *in, int16_t *out, int n, int shift);
+    void (*q15Rotate)(const int16_t *in, const int16_t *cosines, const int16_t *sines, int16_t *out, int n, int shift);
+    void (*q15Butterfly)(int radix, const int16_t *const *in, int16_t *const *out, int n);
+};
+
+/*******************************************************************/
+/* scalar */
+
+static inline void convertInt16Scalar(const int16_t *in, int stride, float *out, int n)
+{
+    for(int i = 0; i < n; ++i) {
+        out[i] = in[i * stride] * INT16_SCALE;
+    }
+}
+
+static inline void deinterleaveInt16Scalar(const int16_t *in, int stride, float *const *out, int channels, int n)
+{
+    for(int c = 0; c < channels; ++c) {
+        convertInt16Scalar(in + c, stride, out[c], n);
+    }
+}
+
+static inline void complexMagnitudeScalar(const float *in, float *out, int n)
+{
+    for(int i = 0; i < n; ++i) {
+        out[i] = std::sqrt(in[2 * i] * in[2 * i] + in[2 * i + 1] * in[2 * i + 1]);
+    }
+}
+
+static inline void meanDeviationScalar(const float *data, int n, double &sum, double &sumSquared)
+{
+    for(int i = 0; i < n; ++i) {
+        sum         += data[i];
+        sumSquared  += static_cast<double>(data[i]) * data[i];
+    }
+}
+
+static inline float dotProductScalar(const float *a, const float *b, int n)
+{
+    float sum = 0.0f;
+    for(int i = 0; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+/* Q15, lane by lane the same operations as pmulhrsw, paddsw and psubsw */
+static inline int16_t saturateInt16(int32_t x)
+{
+    return static_cast<int16_t>(x > 32767 ? 32767 : (x < -32768 ? -32768 : x));
+}
+
+static inline int16_t q15Mul(int16_t a, int16_t b)
+{
+    return saturateInt16((static_cast<int32_t>(a) * b + 0x4000) >> 15);
+}
+
+static inline int16_t q15Add(int16_t a, int16_t b)
+{
+    return saturateInt16(static_cast<int32_t>(a) + b);
+}
+
+static inline int16_t q15Sub(int16_t a, int16_t b)
+{
+    return saturateInt16(static_cast<int32_t>(a) - b);
+}
+
+/* x / 2^shift rounded */
+static inline int16_t q15Shift(int16_t x, int shift)
+{
+    return shift ? q15Mul(x, static_cast<int16_t>(1 << (15 - shift))) : x;
+}
+
+struct Q15Pair {
+    int16_t re, im;
+};
+
+static inline Q15Pair pairAdd(Q15Pair a, Q15Pair b)
+{
+    const Q15Pair r = {q15Add(a.re, b.re), q15Add(a.im, b.im)};
+    return r;
+}
+
+static inline Q15Pair pairSub(Q15Pair a, Q15Pair b)
+{
+    const Q15Pair r = {q15Sub(a.re, b.re), q15Sub(a.im, b.im)};
+    return r;
+}
+
+static inline Q15Pair pairMul(Q15Pair a, int16_t c)
+{
+    const Q15Pair r = {q15Mul(a.re, c), q15Mul(a.im, c)};
+    return r;
+}
+
+/* -i * a, the negation wraps like psignw */
+static inline Q15Pair pairNegI(Q15Pair a)
+{
+    const Q15Pair r = {a.im, static_cast<int16_t>(-a.re)};
+    return r;
+}
+
+/* forward DFT of size radix, the vector versions below follow it operation by operation */
+static inline void radixScalar(int radix, const Q15Pair *x, Q15Pair *y)
+{
+    switch(radix) {
+    case 2:
+        y[0] = pairAdd(x[0], x[1]);
+        y[1] = pairSub(x[0], x[1]);
+        break;
+    case 3: {
+        const Q15Pair t1 = pairAdd(x[1], x[2]);
+        const Q15Pair t2 = pairSub(x[1], x[2]);
+        const Q15Pair m = pairSub(x[0], pairMul(t1, Q15_HALF));
+        const Q15Pair n = pairNegI(pairMul(t2, Q15_SIN60));
+        y[0] = pairAdd(x[0], t1);
+        y[1] = pairAdd(m, n);
+        y[2] = pairSub(m, n);
+        break;
+    }
+    case 4: {
+        const Q15Pair t0 = pairAdd(x[0], x[2]);
+        const Q15Pair t1 = pairSub(x[0], x[2]);
+        const Q15Pair t2 = pairAdd(x[1], x[3]);
+        const Q15Pair t3 = pairNegI(pairSub(x[1], x[3]));
+        y[0] = pairAdd(t0, t2);
+        y[1] = pairAdd(t1, t3);
+        y[2] = pairSub(t0, t2);
+        y[3] = pairSub(t1, t3);
+        break;
+    }
+    default: {
+        const Q15Pair t1 = pairAdd(x[1], x[4]);
+        const Q15Pair t2 = pairAdd(x[2], x[3]);
+        const Q15Pair t3 = pairSub(x[1], x[4]);
+        const Q15Pair t4 = pairSub(x[2], x[3]);
+        const Q15Pair m1 = pairAdd(pairAdd(x[0], pairMul(t1, Q15_COS72)), pairMul(t2, Q15_COS144));
+        const Q15Pair m2 = pairAdd(pairAdd(x[0], pairMul(t1, Q15_COS144)), pairMul(t2, Q15_COS72));
+        const Q15Pair n1 = pairNegI(pairAdd(pairMul(t3, Q15_SIN72), pairMul(t4, Q15_SIN144)));
+        const Q15Pair n2 = pairNegI(pairSub(pairMul(t3, Q15_SIN144), pairMul(t4, Q15_SIN72)));
+        y[0] = pairAdd(pairAdd(x[0], t1), t2);
+        y[1] = pairAdd(m1, n1);
+        y[2] = pairAdd(m2, n2);
+        y[3] = pairSub(m2, n2);
+        y[4] = pairSub(m1, n1);
+        break;
+    }
+    }
+}
+
+static inline int q15MaxAbsScalar(const int16_t *data, int n)
+{
+    int16_t m = 0;
+    for(int i = 0; i < 2 * n; ++i) {
+        m = std::max(m, std::max(data[i], q15Sub(0, data[i])));
+    }
+    return m;
+}
+
+static inline void q15ScaleScalar(const int16_t *in, int16_t *out, int n, int shift)
+{
+    for(int i = 0; i < 2 * n; ++i) {
+        out[i] = q15Shift(in[i], shift);
+    }
+}
+
+static inline void q15RotateScalar(const int16_t *in, const int16_t *cosines, const int16_t *sines, int16_t *out, int n, int shift)
+{
+    for(int i = 0; i < n; ++i) {
+        const int16_t re = q15Shift(in[2 * i], shift);
+        const int16_t im = q15Shift(in[2 * i + 1], shift);
+        out[2 * i]     = q15Add(q15Mul(re, cosines[2 * i]),     q15Mul(im, sines[2 * i]));
+        out[2 * i + 1] = q15Add(q15Mul(im, cosines[2 * i + 1]), q15Mul(re, sines[2 * i + 1]));
+    }
+}
+
+static inline void q15ButterflyScalar(int radix, const int16_t *const *in, int16_t *const *out, int n)
+{
+    Q15Pair x[5] = {}, y[5];
+    for(int i = 0; i < n; ++i) {
+        for(int r = 0; r < radix; ++r) {
+            x[r].re = in[r][2 * i];
+            x[r].im = in[r][2 * i + 1];
+        }
+        radixScalar(radix, x, y);
+        for(int r = 0; r < radix; ++r) {
+            out[r][2 * i]     = y[r].re;
+            out[r][2 * i + 1] = y[r].im;
+        }
+    }
+}
+
+static const KernelTable scalarKernels = {
+    "scalar", &convertInt16Scalar, &deinterleaveInt16Scalar, &complexMagnitudeScalar, &meanDeviationScalar, &dotProductScalar,
+    &q15MaxAbsScalar, &q15ScaleScalar, &q15RotateScalar, &q15ButterflyScalar
+};
+
+#ifdef KERNELS_X86
+/*******************************************************************/
+/* SSE2 */
+
+/* vector loads of width int16s starting at in[i * stride] must not pass the last sample */
+static inline bool loadFits(int i, int stride, int width, int n)
+{
+    return i * stride + width <= (n - 1) * stride + 1;
+}
+
+__attribute__((target("sse2")))
+static void convertInt16SSE2(const int16_t *in, int stride, float *out, int n)
+{
+    const __m128 scale = _mm_set1_ps(INT16_SCALE);
+    int i = 0;
+    if(stride == 1) {
+        for(; loadFits(i, 1, 8, n); i += 8) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            /* sign extend by unpacking into the upper half and shifting down */
+            const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            _mm_storeu_ps(out + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+            _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+        }
+    } else if(stride == 2) {
+        for(; loadFits(i, 2, 8, n); i += 4) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+            /* every other sample is the low half of a 32 bit lane */
+            const __m128i even = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(even), scale));
+        }
+    }
+    convertInt16Scalar(in + i * stride, stride, out + i, n - i);
+}
+
+/* four frames of four channels: two 16 bit unpack rounds transpose them */
+__attribute__((target("sse2")))
+static inline void deinterleave4x4SSE2(const int16_t *in, float *const *out, int i)
+{
+    const __m128 scale = _mm_set1_ps(INT16_SCALE);
+    const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * i));
+    const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * i + 8));
+    const __m128i t0 = _mm_unpacklo_epi16(v0, v1);     /* a0 a2 b0 b2 c0 c2 d0 d2 */
+    const __m128i t1 = _mm_unpackhi_epi16(v0, v1);     /* a1 a3 b1 b3 c1 c3 d1 d3 */
+    const __m128i ab = _mm_unpacklo_epi16(t0, t1);     /* a0 a1 a2 a3 b0 b1 b2 b3 */
+    const __m128i cd = _mm_unpackhi_epi16(t0, t1);
+    _mm_storeu_ps(out[0] + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(ab, ab), 16)), scale));
+    _mm_storeu_ps(out[1] + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(ab, ab), 16)), scale));
+    _mm_storeu_ps(out[2] + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(cd, cd), 16)), scale));
+    _mm_storeu_ps(out[3] + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(cd, cd), 16)), scale));
+}
+
+__attribute__((target("sse2")))
+static void deinterleaveInt16SSE2(const int16_t *in, int stride, float *const *out, int channels, int n)
+{
+    const __m128 scale = _mm_set1_ps(INT16_SCALE);
+    int i = 0;
+    if(stride == 2 && channels == 2) {
+        for(; i + 4 <= n; i += 4) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+            /* the low and the high half of each 32 bit lane */
+            _mm_storeu_ps(out[0] + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16)), scale));
+            _mm_storeu_ps(out[1] + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(v, 16)), scale));
+        }
+    } else if(stride == 4 && channels == 4) {
+        for(; i + 4 <= n; i += 4) {
+            deinterleave4x4SSE2(in, out, i);
+        }
+    } else {
+        for(int c = 0; c < channels; ++c) {
+            convertInt16SSE2(in + c, stride, out[c], n);
+        }
+        return;
+    }
+    for(int c = 0; c < channels; ++c) {
+        convertInt16Scalar(in + i * stride + c, stride, out[c] + i, n - i);
+    }
+}
+
+__attribute__((target("sse2")))
+static void complexMagnitudeSSE2(const float *in, float *out, int n)
+{
+    int i = 0;
+    for(; i + 4 <= n; i += 4) {
+        const __m128 a = _mm_loadu_ps(in + 2 * i);
+        const __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+        const __m128 a2 = _mm_mul_ps(a, a);
+        const __m128 b2 = _mm_mul_ps(b, b);
+        const __m128 re = _mm_shuffle_ps(a2, b2, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 im = _mm_shuffle_ps(a2, b2, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_add_ps(re, im)));
+    }
+    complexMagnitudeScalar(in + 2 * i, out + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void meanDeviationSSE2(const float *data, int n, double &sum, double &sumSquared)
+{
+    __m128d s = _mm_setzero_pd();
+    __m128d q = _mm_setzero_pd();
+    int i = 0;
+    for(; i + 4 <= n; i += 4) {
+        const __m128 v = _mm_loadu_ps(data + i);
+        const __m128d lo = _mm_cvtps_pd(v);
+        const __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+        s = _mm_add_pd(s, _mm_add_pd(lo, hi));
+        q = _mm_add_pd(q, _mm_add_pd(_mm_mul_pd(lo, lo), _mm_mul_pd(hi, hi)));
+    }
+    double sv[2], qv[2];
+    _mm_storeu_pd(sv, s);
+    _mm_storeu_pd(qv, q);
+    sum         += sv[0] + sv[1];
+    sumSquared  += qv[0] + qv[1];
+    meanDeviationScalar(data + i, n - i, sum, sumSquared);
+}
+
+__attribute__((target("sse2")))
+static float dotProductSSE2(const float *a, const float *b, int n)
+{
+    /* two accumulators to hide the latency of the adds */
+    __m128 s0 = _mm_setzero_ps();
+    __m128 s1 = _mm_setzero_ps();
+    int i = 0;
+    for(; i + 8 <= n; i += 8) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i),     _mm_loadu_ps(b + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float sv[4];
+    _mm_storeu_ps(sv, _mm_add_ps(s0, s1));
+    return (sv[0] + sv[1]) + (sv[2] + sv[3]) + dotProductScalar(a + i, b + i, n - i);
+}
+
+static const KernelTable sse2Kernels = {
+    "sse2", &convertInt16SSE2, &deinterleaveInt16SSE2, &complexMagnitudeSSE2, &meanDeviationSSE2, &dotProductSSE2,
+    &q15MaxAbsScalar, &q15ScaleScalar, &q15RotateScalar, &q15ButterflyScalar
+};
+
+/*******************************************************************/
+/* SSSE3 (Atom): pmulhrsw for the Q15 products, the float kernels are the SSE2 ones */
+
+/* (re, im) to (im, re) in every 32 bit lane */
+__attribute__((target("ssse3")))
+static inline __m128i swapPairsSSSE3(__m128i v)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i negISSSE3(__m128i v)
+{
+    return _mm_sign_epi16(swapPairsSSSE3(v), _mm_set_epi16(-1, 1, -1, 1, -1, 1, -1, 1));
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i shiftSSSE3(__m128i v, int shift)
+{
+    return shift ? _mm_mulhrs_epi16(v, _mm_set1_epi16(static_cast<int16_t>(1 << (15 - shift)))) : v;
+}
+
+__attribute__((target("ssse3")))
+static inline void radixSSSE3(int radix, const __m128i *x, __m128i *y)
+{
+    switch(radix) {
+    case 2:
+        y[0] = _mm_adds_epi16(x[0], x[1]);
+        y[1] = _mm_subs_epi16(x[0], x[1]);
+        break;
+    case 3: {
+        const __m128i t1 = _mm_adds_epi16(x[1], x[2]);
+        const __m128i t2 = _mm_subs_epi16(x[1], x[2]);
+        const __m128i m = _mm_subs_epi16(x[0], _mm_mulhrs_epi16(t1, _mm_set1_epi16(Q15_HALF)));
+        const __m128i n = negISSSE3(_mm_mulhrs_epi16(t2, _mm_set1_epi16(Q15_SIN60)));
+        y[0] = _mm_adds_epi16(x[0], t1);
+        y[1] = _mm_adds_epi16(m, n);
+        y[2] = _mm_subs_epi16(m, n);
+        break;
+    }
+    case 4: {
+        const __m128i t0 = _mm_adds_epi16(x[0], x[2]);
+        const __m128i t1 = _mm_subs_epi16(x[0], x[2]);
+        const __m128i t2 = _mm_adds_epi16(x[1], x[3]);
+        const __m128i t3 = negISSSE3(_mm_subs_epi16(x[1], x[3]));
+        y[0] = _mm_adds_epi16(t0, t2);
+        y[1] = _mm_adds_epi16(t1, t3);
+        y[2] = _mm_subs_epi16(t0, t2);
+        y[3] = _mm_subs_epi16(t1, t3);
+        break;
+    }
+    default: {
+        const __m128i c72 = _mm_set1_epi16(Q15_COS72), c144 = _mm_set1_epi16(Q15_COS144);
+        const __m128i s72 = _mm_set1_epi16(Q15_SIN72), s144 = _mm_set1_epi16(Q15_SIN144);
+        const __m128i t1 = _mm_adds_epi16(x[1], x[4]);
+        const __m128i t2 = _mm_adds_epi16(x[2], x[3]);
+        const __m128i t3 = _mm_subs_epi16(x[1], x[4]);
+        const __m128i t4 = _mm_subs_epi16(x[2], x[3]);
+        const __m128i m1 = _mm_adds_epi16(_mm_adds_epi16(x[0], _mm_mulhrs_epi16(t1, c72)), _mm_mulhrs_epi16(t2, c144));
+        const __m128i m2 = _mm_adds_epi16(_mm_adds_epi16(x[0], _mm_mulhrs_epi16(t1, c144)), _mm_mulhrs_epi16(t2, c72));
+        const __m128i n1 = negISSSE3(_mm_adds_epi16(_mm_mulhrs_epi16(t3, s72), _mm_mulhrs_epi16(t4, s144)));
+        const __m128i n2 = negISSSE3(_mm_subs_epi16(_mm_mulhrs_epi16(t3, s144), _mm_mulhrs_epi16(t4, s72)));
+        y[0] = _mm_adds_epi16(_mm_adds_epi16(x[0], t1), t2);
+        y[1] = _mm_adds_epi16(m1, n1);
+        y[2] = _mm_adds_epi16(m2, n2);
+        y[3] = _mm_subs_epi16(m2, n2);
+        y[4] = _mm_subs_epi16(m1, n1);
+        break;
+    }
+    }
+}
+
+__attribute__((target("ssse3")))
+static int q15MaxAbsSSSE3(const int16_t *data, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i m = zero;
+    int i = 0;
+    for(; i + 8 <= 2 * n; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        m = _mm_max_epi16(m, _mm_max_epi16(v, _mm_subs_epi16(zero, v)));
+    }
+    int16_t mv[8];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(mv), m);
+    int result = q15MaxAbsScalar(data + i, (2 * n - i) / 2);
+    for(int k = 0; k < 8; ++k) {
+        result = std::max(result, static_cast<int>(mv[k]));
+    }
+    return result;
+}
+
+__attribute__((target("ssse3")))
+static void q15ScaleSSSE3(const int16_t *in, int16_t *out, int n, int shift)
+{
+    int i = 0;
+    for(; i + 8 <= 2 * n; i += 8) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), shiftSSSE3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), shift));
+    }
+    q15ScaleScalar(in + i, out + i, (2 * n - i) / 2, shift);
+}
+
+__attribute__((target("ssse3")))
+static void q15RotateSSSE3(const int16_t *in, const int16_t *cosines, const int16_t *sines, int16_t *out, int n, int shift)
+{
+    int i = 0;
+    for(; i + 4 <= n; i += 4) {
+        const __m128i v = shiftSSSE3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i)), shift);
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cosines + 2 * i));
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sines + 2 * i));
+        /* (re c - im s, im c + re s) with the sines stored as (-s, s) */
+        const __m128i rotated = _mm_adds_epi16(_mm_mulhrs_epi16(v, c), _mm_mulhrs_epi16(swapPairsSSSE3(v), s));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), rotated);
+    }
+    q15RotateScalar(in + 2 * i, cosines + 2 * i, sines + 2 * i, out + 2 * i, n - i, shift);
+}
+
+__attribute__((target("ssse3")))
+static void q15ButterflySSSE3(int radix, const int16_t *const *in, int16_t *const *out, int n)
+{
+    __m128i x[5], y[5];
+    int i = 0;
+    for(; i + 4 <= n; i += 4) {
+        for(int r = 0; r < radix; ++r) {
+            x[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[r] + 2 * i));
+        }
+        radixSSSE3(radix, x, y);
+        for(int r = 0; r < radix; ++r) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out[r] + 2 * i), y[r]);
+        }
+    }
+    if(i < n) {
+        const int16_t *inTail[5];
+        int16_t *outTail[5];
+        for(int r = 0; r < radix; ++r) {
+            inTail[r] = in[r] + 2 * i;
+            outTail[r] = out[r] + 2 * i;
+        }
+        q15ButterflyScalar(radix, inTail, outTail, n - i);
+    }
+}
+
+static const KernelTable ssse3Kernels = {
+    "ssse3", &convertInt16SSE2, &deinterleaveInt16SSE2, &complexMagnitudeSSE2, &meanDeviationSSE2, &dotProductSSE2,
+    &q15MaxAbsSSSE3, &q15ScaleSSSE3, &q15RotateSSSE3, &q15ButterflySSSE3
+};
+
+/*******************************************************************/
+/* AVX2, the tails stay in VEX encoded code to avoid AVX/SSE transition stalls */
+
+__attribute__((target("avx2")))
+static void convertInt16AVX2(const int16_t *in, int stride, float *out, int n)
+{
+    const __m256 scale = _mm256_set1_ps(INT16_SCALE);
+    int i = 0;
+    if(stride == 1) {
+        for(; loadFits(i, 1, 8, n); i += 8) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)), scale));
+        }
+    } else if(stride == 2) {
+        for(; loadFits(i, 2, 16, n); i += 8) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * i));
+            const __m256i even = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(even), scale));
+        }
+    }
+    convertInt16Scalar(in + i * stride, stride, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void deinterleaveInt16AVX2(const int16_t *in, int stride, float *const *out, int channels, int n)
+{
+    const __m256 scale = _mm256_set1_ps(INT16_SCALE);
+    int i = 0;
+    if(stride == 2 && channels == 2) {
+        for(; i + 8 <= n; i += 8) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * i));
+            _mm256_storeu_ps(out[0] + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16)), scale));
+            _mm256_storeu_ps(out[1] + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(v, 16)), scale));
+        }
+    } else if(stride == 4 && channels == 4) {
+        /* the transpose has no wider form, the 128 bit one runs VEX encoded here */
+        for(; i + 4 <= n; i += 4) {
+            deinterleave4x4SSE2(in, out, i);
+        }
+    } else {
+        for(int c = 0; c < channels; ++c) {
+            convertInt16AVX2(in + c, stride, out[c], n);
+        }
+        return;
+    }
+    for(int c = 0; c < channels; ++c) {
+        convertInt16Scalar(in + i * stride + c, stride, out[c] + i, n - i);
+    }
+}
+
+__attribute__((target("avx2")))
+static void complexMagnitudeAVX2(const float *in, float *out, int n)
+{
+    int i = 0;
+    for(; i + 8 <= n; i += 8) {
+        const __m256 a = _mm256_loadu_ps(in + 2 * i);
+        const __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+        /* pairwise sums per 128 bit lane give |x|^2 in the order 0 1 4 5 2 3 6 7 */
+        const __m256 sq = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+        const __m256 ordered = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sq), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_ps(out + i, _mm256_sqrt_ps(ordered));
+    }
+    complexMagnitudeScalar(in + 2 * i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void meanDeviationAVX2(const float *data, int n, double &sum, double &sumSquared)
+{
+    __m256d s = _mm256_setzero_pd();
+    __m256d q = _mm256_setzero_pd();
+    int i = 0;
+    for(; i + 8 <= n; i += 8) {
+        const __m256 v = _mm256_loadu_ps(data + i);
+        const __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+        const __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+        s = _mm256_add_pd(s, _mm256_add_pd(lo, hi));
+        q = _mm256_add_pd(q, _mm256_add_pd(_mm256_mul_pd(lo, lo), _mm256_mul_pd(hi, hi)));
+    }
+    double sv[4], qv[4];
+    _mm256_storeu_pd(sv, s);
+    _mm256_storeu_pd(qv, q);
+    sum         += (sv[0] + sv[1]) + (sv[2] + sv[3]);
+    sumSquared  += (qv[0] + qv[1]) + (qv[2] + qv[3]);
+    meanDeviationScalar(data + i, n - i, sum, sumSquared);
+}
+
+__attribute__((target("avx2")))
+static float dotProductAVX2(const float *a, const float *b, int n)
+{
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    int i = 0;
+    for(; i + 16 <= n; i += 16) {
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i),     _mm256_loadu_ps(b + i)));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    const __m256 s = _mm256_add_ps(s0, s1);
+    const __m128 h = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+    float sv[4];
+    _mm_storeu_ps(sv, h);
+    return (sv[0] + sv[1]) + (sv[2] + sv[3]) + dotProductScalar(a + i, b + i, n - i);
+}
+
+/* the Q15 transforms are short, 128 bit vectors fill them better */
+static const KernelTable avx2Kernels = {
+    "avx2", &convertInt16AVX2, &deinterleaveInt16AVX2, &complexMagnitudeAVX2, &meanDeviationAVX2, &dotProductAVX2,
+    &q15MaxAbsSSSE3, &q15ScaleSSSE3, &q15RotateSSSE3, &q15ButterflySSSE3
+};
+#endif
+
+#ifdef KERNELS_NEON
+/*******************************************************************/
+/* NEON: vqrdmulh rounds and saturates like the scalar Q15 product, the float kernels are scalar */
+
+static inline int16x8_t swapPairsNEON(int16x8_t v)
+{
+    return vrev32q_s16(v);
+}
+
+static inline int16x8_t negINEON(int16x8_t v)
+{
+    /* the odd (imaginary) lanes are the upper halves of the 32 bit lanes */
+    const uint16x8_t odd = vreinterpretq_u16_u32(vdupq_n_u32(0xffff0000u));
+    const int16x8_t swapped = swapPairsNEON(v);
+    return vbslq_s16(odd, vnegq_s16(swapped), swapped);
+}
+
+static inline int16x8_t shiftNEON(int16x8_t v, int shift)
+{
+    return shift ? vqrdmulhq_s16(v, vdupq_n_s16(static_cast<int16_t>(1 << (15 - shift)))) : v;
+}
+
+static inline void radixNEON(int radix, const int16x8_t *x, int16x8_t *y)
+{
+    switch(radix) {
+    case 2:
+        y[0] = vqaddq_s16(x[0], x[1]);
+        y[1] = vqsubq_s16(x[0], x[1]);
+        break;
+    case 3: {
+        const int16x8_t t1 = vqaddq_s16(x[1], x[2]);
+        const int16x8_t t2 = vqsubq_s16(x[1], x[2]);
+        const int16x8_t m = vqsubq_s16(x[0], vqrdmulhq_s16(t1, vdupq_n_s16(Q15_HALF)));
+        const int16x8_t n = negINEON(vqrdmulhq_s16(t2, vdupq_n_s16(Q15_SIN60)));
+        y[0] = vqaddq_s16(x[0], t1);
+        y[1] = vqaddq_s16(m, n);
+        y[2] = vqsubq_s16(m, n);
+        break;
+    }
+    case 4: {
+        const int16x8_t t0 = vqaddq_s16(x[0], x[2]);
+        const int16x8_t t1 = vqsubq_s16(x[0], x[2]);
+        const int16x8_t t2 = vqaddq_s16(x[1], x[3]);
+        const int16x8_t t3 = negINEON(vqsubq_s16(x[1], x[3]));
+        y[0] = vqaddq_s16(t0, t2);
+        y[1] = vqaddq_s16(t1, t3);
+        y[2] = vqsubq_s16(t0, t2);
+        y[3] = vqsubq_s16(t1, t3);
+        break;
+    }
+    default: {
+        const int16x8_t c72 = vdupq_n_s16(Q15_COS72), c144 = vdupq_n_s16(Q15_COS144);
+        const int16x8_t s72 = vdupq_n_s16(Q15_SIN72), s144 = vdupq_n_s16(Q15_SIN144);
+        const int16x8_t t1 = vqaddq_s16(x[1], x[4]);
+        const int16x8_t t2 = vqaddq_s16(x[2], x[3]);
+        const int16x8_t t3 = vqsubq_s16(x[1], x[4]);
+        const int16x8_t t4 = vqsubq_s16(x[2], x[3]);
+        const int16x8_t m1 = vqaddq_s16(vqaddq_s16(x[0], vqrdmulhq_s16(t1, c72)), vqrdmulhq_s16(t2, c144));
+        const int16x8_t m2 = vqaddq_s16(vqaddq_s16(x[0], vqrdmulhq_s16(t1, c144)), vqrdmulhq_s16(t2, c72));
+        const int16x8_t n1 = negINEON(vqaddq_s16(vqrdmulhq_s16(t3, s72), vqrdmulhq_s16(t4, s144)));
+        const int16x8_t n2 = negINEON(vqsubq_s16(vqrdmulhq_s16(t3, s144), vqrdmulhq_s16(t4, s72)));
+        y[0] = vqaddq_s16(vqaddq_s16(x[0], t1), t2);
+        y[1] = vqaddq_s16(m1, n1);
+        y[2] = vqaddq_s16(m2, n2);
+        y[3] = vqsubq_s16(m2, n2);
+        y[4] = vqsubq_s16(m1, n1);
+        break;
+    }
+    }
+}
+
+static int q15MaxAbsNEON(const int16_t *data, int n)
+{
+    const int16x8_t zero = vdupq_n_s16(0);
+    int16x8_t m = zero;
+    int i = 0;
+    for(; i + 8 <= 2 * n; i += 8) {
+        const int16x8_t v = vld1q_s16(data + i);
+        m = vmaxq_s16(m, vmaxq_s16(v, vqsubq_s16(zero, v)));
+    }
+    int16_t mv[8];
+    vst1q_s16(mv, m);
+    int result = q15MaxAbsScalar(data + i, (2 * n - i) / 2);
+    for(int k = 0; k < 8; ++k) {
+        result = std::max(result, static_cast<int>(mv[k]));
+    }
+    return result;
+}
+
+static void q15ScaleNEON(const int16_t *in, int16_t *out, int n, int shift)
+{
+    int i = 0;
+    for(; i + 8 <= 2 * n; i += 8) {
+        vst1q_s16(out + i, shiftNEON(vld1q_s16(in + i), shift));
+    }
+    q15ScaleScalar(in + i, out + i, (2 * n - i) / 2, shift);
+}
+
+static void q15RotateNEON(const int16_t *in, const int16_t *cosines, const int16_t *sines, int16_t *out, int n, int shift)
+{
+    int i = 0;
+    for(; i + 4 <= n; i += 4) {
+        const int16x8_t v = shiftNEON(vld1q_s16(in + 2 * i), shift);
+        const int16x8_t rotated = vqaddq_s16(vqrdmulhq_s16(v, vld1q_s16(cosines + 2 * i)),
+                                             vqrdmulhq_s16(swapPairsNEON(v), vld1q_s16(sines + 2 * i)));
+        vst1q_s16(out + 2 * i, rotated);
+    }
+    q15RotateScalar(in + 2 * i, cosines + 2 * i, sines + 2 * i, out + 2 * i, n - i, shift);
+}
+
+static void q15ButterflyNEON(int radix, const int16_t *const *in, int16_t *const *out, int n)
+{
+    int16x8_t x[5], y[5];
+    int i = 0;
+    for(; i + 4 <= n; i += 4) {
+        for(int r = 0; r < radix; ++r) {
+            x[r] = vld1q_s16(in[r] + 2 * i);
+        }
+        radixNEON(radix, x, y);
+        for(int r = 0; r < radix; ++r) {
+            vst1q_s16(out[r] + 2 * i, y[r]);
+        }
+    }
+    if(i < n) {
+        const int16_t *inTail[5];
+        int16_t *outTail[5];
+        for(int r = 0; r < radix; ++r) {
+            inTail[r] = in[r] + 2 * i;
+            outTail[r] = out[r] + 2 * i;
+        }
+        q15ButterflyScalar(radix, inTail, outTail, n - i);
+    }
+}
+
+static const KernelTable neonKernels = {
+    "neon", &convertInt16Scalar, &deinterleaveInt16Scalar, &complexMagnitudeScalar, &meanDeviationScalar, &dotProductScalar,
+    &q15MaxAbsNEON, &q15ScaleNEON, &q15RotateNEON, &q15ButterflyNEON
+};
+#endif
+
+/*******************************************************************/
+
+static const KernelTable *detectKernels()
+{
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        return &avx2Kernels;
+    }
+    if(__builtin_cpu_supports("ssse3")) {
+        return &ssse3Kernels;
+    }
+    if(__builtin_cpu_supports("sse2")) {
+        return &sse2Kernels;
+    }
+#endif
+#ifdef KERNELS_NEON
+    return &neonKernels;
+#endif
+    return &scalarKernels;
+}
+
+/* may be switched by a config reload while the audio thread runs */
+static std::atomic<const KernelTable*> kernels(detectKernels());
+
+bool selectKernels(const std::string &name)
+{
+    if(name == "auto") {
+        kernels.store(detectKernels(), std::memory_order_relaxed);
+        return true;
+    }
+    if(name == "scalar") {
+        kernels.store(&scalarKernels, std::memory_order_relaxed);
+        return true;
+    }
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if(name == "sse2" && __builtin_cpu_supports("sse2")) {
+        kernels.store(&sse2Kernels, std::memory_order_relaxed);
+        return true;
+    }
+    if(name == "ssse3" && __builtin_cpu_supports("ssse3")) {
+        kernels.store(&ssse3Kernels, std::memory_order_relaxed);
+        return true;
+    }
+    if(name == "avx2" && __builtin_cpu_supports("avx2")) {
+        kernels.store(&avx2Kernels, std::memory_order_relaxed);
+        return true;
+    }
+#endif
+#ifdef KERNELS_NEON
+    if(name == "neon") {
+        kernels.store(&neonKernels, std::memory_order_relaxed);
+        return true;
+    }
+#endif
+    return false;
+}
+
+const char *kernelName()
+{
+    return kernels.load(std::memory_order_relaxed)->name;
+}
+
+void convertInt16(const int16_t *in, int stride, float *out, int n)
+{
+    kernels.load(std::memory_order_relaxed)->convertInt16(in, stride, out, n);
+}
+
+void deinterleaveInt16(const int16_t *in, int stride, float *const *out, int channels, int n)
+{
+    kernels.load(std::memory_order_relaxed)->deinterleaveInt16(in, stride, out, channels, n);
+}
+
+void complexMagnitude(const float *in, float *out, int n)
+{
+    kernels.load(std::memory_order_relaxed)->complexMagnitude(in, out, n);
+}
+
+void meanDeviation(const float *data, int n, float &mean, float &dev)
+{
+    double sum = 0.0, sumSquared = 0.0;
+    kernels.load(std::memory_order_relaxed)->meanDeviation(data, n, sum, sumSquared);
+
+    const double variance = n * sumSquared - sum * sum;
+    dev  = static_cast<float>(std::sqrt(variance > 0.0 ? variance : 0.0) / n);
+    mean = static_cast<float>(sum / n);
+}
+
+float dotProduct(const float *a, const float *b, int n)
+{
+    return kernels.load(std::memory_order_relaxed)->dotProduct(a, b, n);
+}
+
+int q15MaxAbs(const int16_t *data, int n)
+{
+    return kernels.load(std::memory_order_relaxed)->q15MaxAbs(data, n);
+}
+
+void q15Scale(const int16_t *in, int16_t *out, int n, int shift)
+{
+    kernels.load(std::memory_order_relaxed)->q15Scale(in, out, n, shift);
+}
+
+void q15Rotate(const int16_t *in, const int16_t *cosines, const int16_t *sines, int16_t *out, int n, int shift)
+{
+    kernels.load(std::memory_order_relaxed)->q15Rotate(in, cosines, sines, out, n, shift);
+}
+
+void q15Butterfly(int radix, const int16_t *const *in, int16_t *const *out, int n)
+{
+    kernels.load(std::memory_order_relaxed)->q15Butterfly(radix, in, out, n);
+}
+
+uint32_t integerSqrt(uint64_t x)
+{
+    uint64_t result = 0;
+    uint64_t bit = 1ull << 62;
+    while(bit > x) {
+        bit >>= 2;
+    }
+    while(bit) {
+        if(x >= result + bit) {
+            x -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return static_cast<uint32_t>(result);
+}
@@ -0,0 +1,46 @@
+/*!
+ * \brief Vectorized inner loops (SSE2, SSSE3, AVX2, NEON) with scalar fallback, selected at runtime.
+ */
+
+#ifndef __AK_KERNELS__
+#define __AK_KERNELS__
+
+#include <cstdint>
+#include <string>
+
+/* out[i] = in[i * stride] / 32768 for i < n */
+void convertInt16(const int16_t *in, int stride, float *out, int n);
+
+/* out[c][i] = in[i * stride + c] / 32768 for c < channels and i < n, all channels in one pass */
+void deinterleaveInt16(const int16_t *in, int stride, float *const *out, int channels, int n);
+
+/* out[i] = |in[i]| for n complex numbers stored as (re, im) pairs */
+void complexMagnitude(const float *in, float *out, int n);
+
+/* mean and standard deviation of n values, accumulated in double precision */
+void meanDeviation(const float *data, int n, float &mean, float &dev);
+
+/* sum of a[i] * b[i] for i < n */
+float dotProduct(const float *a, const float *b, int n);
+
+/* Q15 fixed point, complex values are interleaved (re, im) int16 pairs: products round as
+ * (a * b + 2^14) >> 15 and sums saturate the same way in every set, so all give the same bits */
+
+/* largest |re| or |im| of n complex values, |-32768| counts as 32767 */
+int q15MaxAbs(const int16_t *data, int n);
+/* out[i] = in[i] / 2^shift rounded, shift 0 - 15 */
+void q15Scale(const int16_t *in, int16_t *out, int n, int shift);
+/* out[i] = in[i] / 2^shift * w[i], the twiddles w = c + is given as pairs (c, c) and (-s, s) */
+void q15Rotate(const int16_t *in, const int16_t *cosines, const int16_t *sines, int16_t *out, int n, int shift);
+/* forward DFTs of size radix (2, 3, 4 or 5) from in[0][i] .. in[radix - 1][i] to out[0][i] .., i < n */
+void q15Butterfly(int radix, const int16_t *const *in, int16_t *const *out, int n);
+
+/* floor of the square root */
+uint32_t integerSqrt(uint64_t x);
+
+/* "auto" picks the best set the CPU supports, otherwise "scalar", "sse2", "ssse3", "avx2" or "neon";
+ * returns false if the requested set is unknown or not supported */
+bool selectKernels(const std::string &name);
+const char *kernelName();
+
+#endif
@@ -0,0 +1,229 @@
+/*!
+ * \brief Short Time Fourier Transform of all microphones at once, fused into one magnitude
+ *        spectrum per window for the detector.
+ */
+
+#include "MultiChannelSTFT.h"
+#include "Kernels.h"
+#include "Timing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+bool parseFusionMode(const std::string &name, FusionMode &mode)
+{
+    if(name == "none") {
+        mode = FUSION_NONE;
+    } else if(name == "max") {
+        mode = FUSION_MAX;
+    } else if(name == "power") {
+        mode = FUSION_POWER;
+    } else if(name == "delaysum") {
+        mode = FUSION_DELAY_SUM;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *fusionName(FusionMode mode)
+{
+    switch(mode) {
+    case FUSION_MAX:        return "max";
+    case FUSION_POWER:      return "power";
+    case FUSION_DELAY_SUM:  return "delaysum";
+    default:                return "none";
+    }
+}
+
+/* frames of a buffer taken at once, the rows hold them and the kept samples of a window */
+#define CHUNK_FRAMES        (1024)
+
+MultiChannelSTFT::MultiChannelSTFT(const int channels, const int windowTime, const int windowTimeStep, const int windowFrequency,
+                                   FusionMode fusion, const std::vector<float> &delays,
+                                   std::function<void (const float *spectrum, int length)> handleSpectrum)
+    : channels(channels), windowTime(windowTime), windowTimeStep(windowTimeStep),
+      windowFrequency(windowFrequency), windowFrequencyHalf(windowFrequency / 2 + 1),
+      fusion(fusion), handleFused(handleSpectrum),
+      input(NULL), output(NULL), outputMag(NULL), plan(NULL),
+      rows(channels, NULL), rowLength(windowTime + CHUNK_FRAMES), nKept(0), nSkip(0), warnedChannels(false)
+{
+    input     = static_cast<float*>(fftwf_malloc(sizeof(float) * windowFrequency * channels));
+    output    = static_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * windowFrequencyHalf * channels));
+    outputMag = new float[windowFrequencyHalf * channels];
+    if(windowFrequency < windowTime) {
+        std::cerr << "Warning: Frequency window must be greater than Time Window." << std::endl;
+    }
+
+    plan = refiner.create(windowFrequency, channels, input, output);
+    /* after planning, FFTW_MEASURE overwrites the arrays; the padding stays zero from now on */
+    for(int i = 0; i < windowFrequency * channels; ++i) {
+        input[i] = 0.0f;
+    }
+
+    streams.resize(static_cast<size_t>(channels) * rowLength);
+
+    if(fusion == FUSION_DELAY_SUM) {
+        /* a channel delayed by d samples is advanced by exp(2 pi i k d / N) in bin k, the 1 / channels
+         * of the mean is part of it */
+        steering.resize(static_cast<size_t>(channels) * windowFrequencyHalf);
+        aligned.resize(windowFrequencyHalf);
+        for(int c = 0; c < channels; ++c) {
+            const double delay = c < static_cast<int>(delays.size()) ? delays[c] : 0.0;
+            for(int k = 0; k < windowFrequencyHalf; ++k) {
+                steering[c * windowFrequencyHalf + k] = std::polar(1.0f / channels, static_cast<float>(2.0 * M_PI * k * delay / windowFrequency));
+            }
+        }
+    }
+}
+
+MultiChannelSTFT::~MultiChannelSTFT()
+{
+    if(plan) {
+        destroyPlan(plan);
+    }
+    fftwf_free(input);
+    fftwf_free(output);
+    delete[] outputMag;
+}
+
+void MultiChannelSTFT::restart()
+{
+    nKept = 0;
+    nSkip = 0;
+}
+
+void MultiChannelSTFT::addSpectrumTap(std::function<void (const float *spectrum, int length)> tap)
+{
+    fusedTaps.push_back(tap);
+}
+
+void MultiChannelSTFT::fuse()
+{
+    const int n = windowFrequencyHalf;
+    const float *spectra = reinterpret_cast<const float*>(output);
+
+    switch(fusion) {
+    case FUSION_DELAY_SUM: {
+        const std::complex<float> *bins = reinterpret_cast<const std::complex<float>*>(output);
+        for(int k = 0; k < n; ++k) {
+            aligned[k] = bins[k] * steering[k];
+        }
+        for(int c = 1; c < channels; ++c) {
+            for(int k = 0; k < n; ++k) {
+                aligned[k] += bins[c * n + k] * steering[c * n + k];
+            }
+        }
+        complexMagnitude(reinterpret_cast<const float*>(&aligned[0]), outputMag, n);
+        break;
+    }
+    case FUSION_POWER:
+        for(int k = 0; k < n; ++k) {
+            float power = 0.0f;
+            for(int c = 0; c < channels; ++c) {
+                const float *bin = spectra + 2 * (c * n + k);
+                power += bin[0] * bin[0] + bin[1] * bin[1];
+            }
+            outputMag[k] = std::sqrt(power / channels);
+        }
+        break;
+    default:
+        /* magnitudes of all channels, then the maximum into the first one */
+        complexMagnitude(spectra, outputMag, n * channels);
+        for(int c = 1; c < channels; ++c) {
+            const float *magnitudes = outputMag + c * n;
+            for(int k = 0; k < n; ++k) {
+                outputMag[k] = std::max(outputMag[k], magnitudes[k]);
+            }
+        }
+        break;
+    }
+}
+
+void MultiChannelSTFT::transformChannels()
+{
+    {
+        StageTimer timer(TIMING_FFT);
+        fftwf_execute_dft_r2c(plan, input, output);
+    }
+
+    {
+        StageTimer timer(TIMING_MAGNITUDE);
+        fuse();
+    }
+
+    for(size_t i = 0; i < fusedTaps.size(); ++i) {
+        fusedTaps[i](outputMag, windowFrequencyHalf);
+    }
+
+    StageTimer timer(TIMING_SPECTRUM);
+    handleFused(outputMag, windowFrequencyHalf);
+}
+
+void MultiChannelSTFT::newData(const int16_t *data, int length, short streamChannels)
+{
+    refiner.adopt(plan);
+    if(std::min(channels, static_cast<int>(streamChannels)) < channels && !warnedChannels) {
+        std::cerr << "Warning: " << streamChannels << " channel(s) recorded, " << channels
+                  << " fused, the missing ones repeat channel 0." << std::endl;
+        warnedChannels = true;
+    }
+
+    /* at most windowTime - 1 samples are kept, a chunk always fits behind them */
+    while(length > 0) {
+        if(nSkip > 0) {
+            const int skipped = std::min(nSkip, length);
+            data   += skipped * streamChannels;
+            length -= skipped;
+            nSkip  -= skipped;
+            continue;
+        }
+        const int chunk = std::min(length, rowLength - nKept);
+        process(data, chunk, streamChannels);
+        data   += chunk * streamChannels;
+        length -= chunk;
+    }
+}
+
+void MultiChannelSTFT::process(const int16_t *data, int length, short streamChannels)
+{
+    const int used = std::min(channels, static_cast<int>(streamChannels));
+
+    /* all channels of the chunk in one pass, appended to the kept samples */
+    {
+        StageTimer timer(TIMING_CONVERT);
+        for(int c = 0; c < channels; ++c) {
+            rows[c] = &streams[c * rowLength + nKept];
+        }
+        deinterleaveInt16(data, streamChannels, &rows[0], used, length);
+        for(int c = used; c < channels; ++c) {
+            memcpy(rows[c], rows[0], length * sizeof(float));
+        }
+    }
+
+    const int total = nKept + length;
+    int iBegin = 0;
+    while(iBegin + windowTime <= total) {
+        {
+            StageTimer timer(TIMING_CONVERT);
+            for(int c = 0; c < channels; ++c) {
+                memcpy(input + c * windowFrequency, &streams[c * rowLength + iBegin], windowTime * sizeof(float));
+            }
+        }
+        transformChannels();
+        iBegin += windowTimeStep;
+    }
+
+    if(iBegin >= total) {
+        /* the window step is larger than the window, the next chunk starts after the gap */
+        nKept = 0;
+        nSkip = iBegin - total;
+    } else {
+        nKept = total - iBegin;
+        for(int c = 0; c < channels; ++c) {
+            memmove(&streams[c * rowLength], &streams[c * rowLength + iBegin], nKept * sizeof(float));
+        }
+    }
+}
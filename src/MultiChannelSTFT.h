@@ -0,0 +1,80 @@
+/*!
+ * \brief Short Time Fourier Transform of all microphones at once, fused into one magnitude
+ *        spectrum per window for the detector.
+ */
+
+#ifndef __AK_MULTI_CHANNEL_STFT__
+#define __AK_MULTI_CHANNEL_STFT__
+
+#include "Planner.h"
+#include <fftw3.h>
+#include <complex>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum FusionMode {
+    FUSION_NONE,        /* channel 0 only, the plain STFT */
+    FUSION_MAX,         /* largest magnitude of all channels per bin */
+    FUSION_POWER,       /* root of the mean power of all channels per bin */
+    FUSION_DELAY_SUM    /* magnitude of the mean of the channels aligned by their delays */
+};
+
+/* "none", "max", "power" or "delaysum", false if unknown */
+bool parseFusionMode(const std::string &name, FusionMode &mode);
+const char *fusionName(FusionMode mode);
+
+/* one batched transform of a window per channel, planned like STFT (see Planner.h) */
+class MultiChannelSTFT
+{
+public:
+    /* delays: per channel in samples, the arrival after channel 0 of the wanted direction (empty: all 0) */
+    MultiChannelSTFT(const int channels, const int windowTime, const int windowTimeStep, const int windowFrequency,
+                     FusionMode fusion, const std::vector<float> &delays,
+                     std::function<void (const float *spectrum, int length)> handleSpectrum);
+    ~MultiChannelSTFT();
+
+    /* buffers of any length, never allocates: longer ones are taken in chunks */
+    void newData(const int16_t *data, int length, short channels);
+    /* the next buffer starts a new stream */
+    void restart();
+
+    /* gets every fused spectrum before the handler */
+    void addSpectrumTap(std::function<void (const float *spectrum, int length)> tap);
+
+    int getChannels() const { return channels; }
+
+protected:
+    /* at most rowLength - nKept frames */
+    void process(const int16_t *data, int length, short streamChannels);
+    void transformChannels();
+    void fuse();
+
+    const int channels;
+    const int windowTime, windowTimeStep, windowFrequency, windowFrequencyHalf;
+    const FusionMode fusion;
+    std::function<void (const float *spectrum, int length)> handleFused;
+    std::vector<std::function<void (const float *spectrum, int length)> > fusedTaps;
+
+    float *input;
+    fftwf_complex *output;
+    float *outputMag;           /* magnitudes of all channels, the fused one first */
+    PlanRefiner refiner;
+    fftwf_plan plan;
+
+    /* per channel rows of the float stream: kept samples followed by the new chunk */
+    std::vector<float> streams;
+    std::vector<float*> rows;
+    int rowLength, nKept, nSkip;
+    bool warnedChannels;
+
+    std::vector<std::complex<float> > steering;    /* per channel and bin, delay and sum only */
+    std::vector<std::complex<float> > aligned;
+
+private:
+    MultiChannelSTFT(const MultiChannelSTFT&);
+    MultiChannelSTFT &operator=(const MultiChannelSTFT&);
+};
+
+#endif
@@ -0,0 +1,157 @@
+/*!
+ * \brief Per bin noise floor of the whistle band, tracked over frames instead of taken from the
+ *        statistics of every single spectrum.
+ */
+
+#include "NoiseFloor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define MIN_SPREAD      (1e-6f)     /* digital silence */
+#define IQR_TO_DEV      (1.0f / 1.349f) /* interquartile range of a normal distribution */
+
+bool parseNoiseFloorMode(const std::string &name, NoiseFloorMode &mode)
+{
+    if(name == "frame") {
+        mode = NOISE_FLOOR_FRAME;
+    } else if(name == "ema") {
+        mode = NOISE_FLOOR_EMA;
+    } else if(name == "percentile") {
+        mode = NOISE_FLOOR_PERCENTILE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *noiseFloorName(NoiseFloorMode mode)
+{
+    switch(mode) {
+    case NOISE_FLOOR_EMA:           return "ema";
+    case NOISE_FLOOR_PERCENTILE:    return "percentile";
+    default:                        return "frame";
+    }
+}
+
+NoiseFloor::NoiseFloor(int bins, NoiseFloorMode mode, int frames, float percentile)
+    : bins(bins), mode(mode), frames(std::max(frames, 2)), percentile(std::min(std::max(percentile, 0.0f), 1.0f)),
+      learned(0), iHistory(0)
+{
+    if(mode == NOISE_FLOOR_EMA) {
+        means.resize(bins);
+        variances.resize(bins);
+        aboveFrames.resize(bins);
+    } else if(mode == NOISE_FLOOR_PERCENTILE) {
+        history.resize(static_cast<size_t>(bins) * this->frames);
+        sorted.resize(static_cast<size_t>(bins) * this->frames);
+    }
+    reset();
+}
+
+void NoiseFloor::reset()
+{
+    learned = 0;
+    iHistory = 0;
+    std::fill(means.begin(), means.end(), 0.0f);
+    std::fill(variances.begin(), variances.end(), 0.0f);
+    std::fill(aboveFrames.begin(), aboveFrames.end(), 0);
+}
+
+void NoiseFloor::continueFrom(const NoiseFloor &previous)
+{
+    if(previous.mode != mode || previous.bins != bins || previous.frames != frames) {
+        return;
+    }
+    learned     = previous.learned;
+    iHistory    = previous.iHistory;
+    means       = previous.means;
+    variances   = previous.variances;
+    aboveFrames = previous.aboveFrames;
+    history     = previous.history;
+    sorted      = previous.sorted;
+}
+
+bool NoiseFloor::update(const float *band, float threshold)
+{
+    if(mode == NOISE_FLOOR_PERCENTILE) {
+        return updatePercentile(band, threshold);
+    }
+    return updateEma(band, threshold);
+}
+
+bool NoiseFloor::updateEma(const float *band, float threshold)
+{
+    /* plain average until the time constant is reached */
+    const bool deciding = learned >= frames;
+    const float alpha = deciding ? 1.0f / frames : 1.0f / (learned + 1);
+    bool found = false;
+
+    for(int i = 0; i < bins; ++i) {
+        const float limit = means[i] + threshold * std::max(std::sqrt(variances[i]), MIN_SPREAD);
+        const bool above = band[i] > limit;
+        found |= above;
+
+        /* a bin above the floor is frozen, unless it stays there longer than the time constant
+         * (the noise got louder) */
+        if(deciding && above && aboveFrames[i] < frames) {
+            ++aboveFrames[i];
+            continue;
+        }
+        aboveFrames[i] = 0;
+
+        /* incremental exponentially weighted mean and variance */
+        const float delta = band[i] - means[i];
+        means[i]     += alpha * delta;
+        variances[i]  = (1.0f - alpha) * (variances[i] + alpha * delta * delta);
+    }
+
+    if(!deciding) {
+        ++learned;
+        return false;
+    }
+    return found;
+}
+
+bool NoiseFloor::updatePercentile(const float *band, float threshold)
+{
+    const bool deciding = learned >= frames;
+    const int n = deciding ? frames : learned;
+    const int iFloor = static_cast<int>(percentile * (n - 1) + 0.5f);
+    const int iLow   = (n - 1) / 4;
+    const int iHigh  = (3 * (n - 1) + 3) / 4;
+    bool found = false;
+
+    for(int i = 0; i < bins; ++i) {
+        float *window = &sorted[static_cast<size_t>(i) * frames];
+        float *ring   = &history[static_cast<size_t>(i) * frames];
+
+        float x = band[i];
+        if(deciding) {
+            const float spread = std::max((window[iHigh] - window[iLow]) * IQR_TO_DEV, MIN_SPREAD);
+            const float limit = window[iFloor] + threshold * spread;
+            if(x > limit) {
+                found = true;
+                x = limit;
+            }
+
+            /* drop the oldest value from the sorted window */
+            float *old = std::lower_bound(window, window + n, ring[iHistory]);
+            memmove(old, old + 1, (window + n - old - 1) * sizeof(float));
+        }
+
+        /* insert the new one, n - 1 values are sorted now */
+        const int count = deciding ? n - 1 : n;
+        float *pos = std::upper_bound(window, window + count, x);
+        memmove(pos + 1, pos, (window + count - pos) * sizeof(float));
+        *pos = x;
+        ring[iHistory] = x;
+    }
+
+    iHistory = (iHistory + 1) % frames;
+    if(!deciding) {
+        ++learned;
+        return false;
+    }
+    return found;
+}
@@ -0,0 +1,60 @@
+/*!
+ * \brief Per bin noise floor of the whistle band, tracked over frames instead of taken from the
+ *        statistics of every single spectrum.
+ */
+
+#ifndef __AK_NOISE_FLOOR__
+#define __AK_NOISE_FLOOR__
+
+#include <string>
+#include <vector>
+
+enum NoiseFloorMode {
+    NOISE_FLOOR_FRAME,          /* mean and deviation of each whole spectrum (no tracking) */
+    NOISE_FLOOR_EMA,            /* exponential moving average and deviation per bin */
+    NOISE_FLOOR_PERCENTILE      /* running percentile and interquartile spread per bin */
+};
+
+/* "frame", "ema" or "percentile", false if unknown */
+bool parseNoiseFloorMode(const std::string &name, NoiseFloorMode &mode);
+const char *noiseFloorName(NoiseFloorMode mode);
+
+class NoiseFloor
+{
+public:
+    /* frames: time constant (ema) or window length (percentile), also the frames learned before
+     * the first decision; percentile: the floor for NOISE_FLOOR_PERCENTILE (0.5: median) */
+    NoiseFloor(int bins, NoiseFloorMode mode, int frames, float percentile = 0.5f);
+
+    /* true if a bin is above floor + threshold * spread, then learns the frame; a whistle does
+     * not raise its own floor (ema: bins above are frozen for up to frames, percentile: they
+     * count as the threshold) */
+    bool update(const float *band, float threshold);
+    void reset();
+
+    /* keeps the learned floor of a tracker with the same mode and size */
+    void continueFrom(const NoiseFloor &previous);
+
+    NoiseFloorMode getMode() const { return mode; }
+    bool isLearning() const { return learned < frames; }
+
+protected:
+    bool updateEma(const float *band, float threshold);
+    bool updatePercentile(const float *band, float threshold);
+
+    const int bins;
+    const NoiseFloorMode mode;
+    const int frames;
+    const float percentile;
+    int learned;
+
+    /* ema: per bin */
+    std::vector<float> means, variances;
+    std::vector<int> aboveFrames;
+
+    /* percentile: per bin the last frames in arrival order (ring) and sorted */
+    std::vector<float> history, sorted;
+    int iHistory;
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*!
+ * \brief Serialized FFTW planning with wisdom stored on disk.
+ */
+
+#include "Planner.h"
+#include <pthread.h>
+#include <iostream>
+#include <mutex>
+
+/* the FFTW planner (including wisdom) is not thread safe */
+static std::mutex plannerMutex;
+
+static std::string wisdomPath;
+static bool backgroundPlanning = false;
+
+void setPlanning(const std::string &wisdomFile, bool background)
+{
+    std::lock_guard<std::mutex> lock(plannerMutex);
+    wisdomPath          = wisdomFile;
+    backgroundPlanning  = background;
+}
+
+bool isBackgroundPlanning()
+{
+    std::lock_guard<std::mutex> lock(plannerMutex);
+    return backgroundPlanning;
+}
+
+bool importWisdom(const std::string &wisdomFile)
+{
+    std::lock_guard<std::mutex> lock(plannerMutex);
+    if(!fftwf_import_wisdom_from_filename(wisdomFile.c_str())) {
+        std::cerr << "cannot import FFTW wisdom from " << wisdomFile << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool exportWisdom()
+{
+    std::lock_guard<std::mutex> lock(plannerMutex);
+    if(wisdomPath.empty()) {
+        return false;
+    }
+    if(!fftwf_export_wisdom_to_filename(wisdomPath.c_str())) {
+        std::cerr << "cannot export FFTW wisdom to " << wisdomPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+fftwf_plan planTransforms(int n, int howmany, float *in, fftwf_complex *out, unsigned flags)
+{
+    std::lock_guard<std::mutex> lock(plannerMutex);
+    return fftwf_plan_many_dft_r2c(1, &n, howmany,
+                                   in,  NULL, 1, n,
+                                   out, NULL, 1, n / 2 + 1, flags);
+}
+
+void destroyPlan(fftwf_plan plan)
+{
+    std::lock_guard<std::mutex> lock(plannerMutex);
+    fftwf_destroy_plan(plan);
+}
+
+/*******************************************************************/
+PlanRefiner::PlanRefiner()
+    : refined(NULL), retired(NULL)
+{
+}
+
+PlanRefiner::~PlanRefiner()
+{
+    if(thread.joinable()) {
+        thread.join();
+    }
+    if(refined.load()) {
+        destroyPlan(refined.load());
+    }
+    if(retired) {
+        destroyPlan(retired);
+    }
+}
+
+fftwf_plan PlanRefiner::create(int n, int howmany, float *in, fftwf_complex *out)
+{
+    fftwf_plan p = planTransforms(n, howmany, in, out, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+    if(p) {
+        return p;
+    }
+    if(!isBackgroundPlanning() || thread.joinable()) {
+        p = planTransforms(n, howmany, in, out, FFTW_MEASURE);
+        exportWisdom();
+        return p;
+    }
+
+    std::cerr << "Warning: no FFTW wisdom for " << howmany << " x " << n
+              << " points, estimating until the plan is measured in the background." << std::endl;
+    /* estimated before the measurement takes the planner lock for the whole run */
+    p = planTransforms(n, howmany, in, out, FFTW_ESTIMATE);
+    thread = std::thread(&PlanRefiner::refine, this, n, howmany);
+    pthread_setname_np(thread.native_handle(), "WhistlePlanner");
+    return p;
+}
+
+void PlanRefiner::refine(int n, int howmany)
+{
+    /* measure on scratch arrays, the plan is executed on the real ones with the new-array interface */
+    float *in = static_cast<float*>(fftwf_malloc(sizeof(float) * n * howmany));
+    fftwf_complex *out = static_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * (n / 2 + 1) * howmany));
+
+    fftwf_plan p = planTransforms(n, howmany, in, out, FFTW_MEASURE);
+
+    fftwf_free(in);
+    fftwf_free(out);
+
+    if(p) {
+        refined.store(p, std::memory_order_release);
+        exportWisdom();
+    }
+}
+
+void PlanRefiner::adopt(fftwf_plan &plan)
+{
+    if(!refined.load(std::memory_order_relaxed)) {
+        return;
+    }
+    retired = plan;
+    plan = refined.exchange(NULL, std::memory_order_acquire);
+}
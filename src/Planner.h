@@ -0,0 +1,55 @@
+/*!
+ * \brief Serialized FFTW planning with wisdom stored on disk.
+ */
+
+#ifndef __AK_PLANNER__
+#define __AK_PLANNER__
+
+#include <fftw3.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+/* wisdom file to load plans from and to store background plans to (empty: none),
+ * background: plans without wisdom start with FFTW_ESTIMATE and are measured in a
+ * background thread, otherwise they are measured right away */
+void setPlanning(const std::string &wisdomFile, bool background);
+bool isBackgroundPlanning();
+
+/* merges the wisdom of the file into the current wisdom */
+bool importWisdom(const std::string &wisdomFile);
+/* writes all current wisdom to the configured file */
+bool exportWisdom();
+
+/* howmany consecutive real to complex transforms of size n (input distance n, output distance
+ * n / 2 + 1), NULL if FFTW_WISDOM_ONLY is given and there is no wisdom for it */
+fftwf_plan planTransforms(int n, int howmany, float *in, fftwf_complex *out, unsigned flags);
+void destroyPlan(fftwf_plan plan);
+
+/* one plan of a transform: from wisdom, otherwise measured right away or, with background
+ * planning, estimated and measured in a thread of its own until the processing thread adopts it */
+class PlanRefiner
+{
+public:
+    PlanRefiner();
+    /* waits for the measurement, destroys the plans not handed out */
+    ~PlanRefiner();
+
+    fftwf_plan create(int n, int howmany, float *in, fftwf_complex *out);
+    /* processing thread: replaces plan by the measured one once it is ready, the replaced one is
+     * destroyed later (destroying takes the planner lock, which a background planner may hold) */
+    void adopt(fftwf_plan &plan);
+
+protected:
+    void refine(int n, int howmany);
+
+    std::thread thread;
+    std::atomic<fftwf_plan> refined;
+    fftwf_plan retired;
+
+private:
+    PlanRefiner(const PlanRefiner&);
+    PlanRefiner &operator=(const PlanRefiner&);
+};
+
+#endif
@@ -0,0 +1,377 @@
+/*!
+ * \brief Keeps the last seconds of capture (and optionally the spectra) in memory and dumps the
+ *        audio around a whistle to disk from a writer thread, to look at false and missed whistles.
+ */
+
+#include "PreTriggerRecorder.h"
+#include "Spectrogram.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+
+#define DUMP_QUEUE      (16)    /* triggers pending at most */
+#define DUMP_POLL_MS    (100)   /* checks for the audio after the detection */
+#define WAV_HEADER_SIZE (44)
+
+static void writeLE16(uint8_t *out, uint16_t value)
+{
+    out[0] = value & 0xff;
+    out[1] = value >> 8;
+}
+
+static void writeLE32(uint8_t *out, uint32_t value)
+{
+    writeLE16(out, value & 0xffff);
+    writeLE16(out + 2, value >> 16);
+}
+
+/* one writev per file, continued after partial writes */
+static bool writeAll(int fd, struct iovec *iov, int count)
+{
+    while(count > 0) {
+        const ssize_t n = writev(fd, iov, count);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        size_t done = static_cast<size_t>(n);
+        while(count > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if(count > 0) {
+            iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + done;
+            iov->iov_len -= done;
+        }
+    }
+    return true;
+}
+
+PreTriggerRecorder::PreTriggerRecorder(const std::string &directory, unsigned sampleRate, short channels,
+                                       float seconds, float before, float after)
+    : directory(directory), sampleRate(sampleRate), channels(channels),
+      capacity(static_cast<uint64_t>(seconds * sampleRate)),
+      beforeFrames(static_cast<uint64_t>(before * sampleRate)), afterFrames(static_cast<uint64_t>(after * sampleRate)),
+      ring(static_cast<size_t>(capacity) * channels, 0), reserved(0), written(0),
+      spectrumRate(0), windowSize(0), paddedSize(0), hop(0), bins(0), spectrumCapacity(0),
+      spectraReserved(0), spectraWritten(0),
+      requests(DUMP_QUEUE), manualFrame(0), manualPending(false), running(false), dumps(0), dropped(0),
+      otherChannels(0), sequence(0)
+{
+    sem_init(&semaphore, 0, 0);
+}
+
+PreTriggerRecorder::~PreTriggerRecorder()
+{
+    stop();
+    sem_destroy(&semaphore);
+}
+
+void PreTriggerRecorder::keepSpectra(unsigned spectrumRate, int windowSize, int paddedSize, int hop)
+{
+    this->spectrumRate = spectrumRate;
+    this->windowSize = windowSize;
+    this->paddedSize = paddedSize;
+    this->hop = hop;
+    bins = paddedSize / 2 + 1;
+    /* as many windows as the ring has seconds, at the processing rate */
+    spectrumCapacity = capacity * spectrumRate / sampleRate / hop + 1;
+    spectra.assign(static_cast<size_t>(spectrumCapacity) * bins, 0.0f);
+    spectrumFrames.assign(static_cast<size_t>(spectrumCapacity), 0);
+    spectrum.resize(bins);
+}
+
+bool PreTriggerRecorder::matchesSpectra(int windowSize, int paddedSize, int hop) const
+{
+    return hasSpectra() && windowSize == this->windowSize && paddedSize == this->paddedSize && hop == this->hop;
+}
+
+bool PreTriggerRecorder::start()
+{
+    if(running) {
+        std::cerr << "Double initialization" << std::endl;
+        return false;
+    }
+    if(mkdir(directory.c_str(), 0755) < 0 && errno != EEXIST) {
+        std::cerr << "cannot create " << directory << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    running = true;
+    thread = std::thread(&PreTriggerRecorder::main, this);
+    pthread_setname_np(thread.native_handle(), "WhistleDumps");
+    return true;
+}
+
+void PreTriggerRecorder::stop()
+{
+    if(!thread.joinable()) {
+        return;
+    }
+    running = false;
+    sem_post(&semaphore);
+    thread.join();
+}
+
+void PreTriggerRecorder::write(const int16_t *data, int length, short streamChannels)
+{
+    if(streamChannels != channels) {
+        /* reported by the writer thread */
+        otherChannels.store(streamChannels, std::memory_order_relaxed);
+        return;
+    }
+
+    /* readers check reserved after copying, frames it reaches may be torn */
+    const uint64_t w = written.load(std::memory_order_relaxed);
+    reserved.store(w + length, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const uint64_t skipped = static_cast<uint64_t>(length) > capacity ? length - capacity : 0;
+    uint64_t frame = w + skipped;
+    data += skipped * channels;
+    while(frame < w + length) {
+        const size_t begin = static_cast<size_t>(frame % capacity);
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(w + length - frame, capacity - begin));
+        memcpy(&ring[begin * channels], data, n * channels * sizeof(int16_t));
+        data += n * channels;
+        frame += n;
+    }
+
+    written.store(w + length, std::memory_order_release);
+}
+
+void PreTriggerRecorder::writeSpectrum(const float *data, int length)
+{
+    if(length != bins) {
+        return;
+    }
+    const uint64_t w = spectraWritten.load(std::memory_order_relaxed);
+    spectraReserved.store(w + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const size_t slot = static_cast<size_t>(w % spectrumCapacity);
+    memcpy(&spectra[slot * bins], data, bins * sizeof(float));
+    spectrumFrames[slot] = written.load(std::memory_order_relaxed);
+
+    spectraWritten.store(w + 1, std::memory_order_release);
+}
+
+bool PreTriggerRecorder::trigger(const WhistleEvent &event)
+{
+    DumpRequest request;
+    const uint64_t onset = event.position * sampleRate / 1000000000ull;
+    request.begin = onset > beforeFrames ? onset - beforeFrames : 0;
+    request.end = written.load(std::memory_order_relaxed) + afterFrames;
+    strncpy(request.name, event.profile[0] ? event.profile : "whistle", sizeof(request.name) - 1);
+    request.name[sizeof(request.name) - 1] = '\0';
+
+    if(!requests.write(&request, 1)) {
+        ++dropped;
+        return false;
+    }
+    sem_post(&semaphore);
+    return true;
+}
+
+void PreTriggerRecorder::triggerNow()
+{
+    manualFrame.store(written.load(std::memory_order_acquire), std::memory_order_relaxed);
+    manualPending.store(true, std::memory_order_release);
+    sem_post(&semaphore);
+}
+
+void PreTriggerRecorder::main()
+{
+    while(true) {
+        if(pending.empty()) {
+            while(sem_wait(&semaphore) < 0 && errno == EINTR) {
+            }
+        } else {
+            /* waiting for the audio after a detection */
+            struct timespec timeout;
+            clock_gettime(CLOCK_REALTIME, &timeout);
+            timeout.tv_nsec += DUMP_POLL_MS * 1000000L;
+            if(timeout.tv_nsec >= 1000000000L) {
+                timeout.tv_nsec -= 1000000000L;
+                ++timeout.tv_sec;
+            }
+            while(sem_timedwait(&semaphore, &timeout) < 0 && errno == EINTR) {
+            }
+        }
+        const bool last = !running;
+
+        size_t n;
+        const DumpRequest *queued = requests.peek(n);
+        while(n > 0) {
+            pending.insert(pending.end(), queued, queued + n);
+            requests.consume(n);
+            queued = requests.peek(n);
+        }
+        if(manualPending.exchange(false, std::memory_order_acquire)) {
+            DumpRequest request;
+            const uint64_t frame = manualFrame.load(std::memory_order_relaxed);
+            request.begin = frame > beforeFrames ? frame - beforeFrames : 0;
+            request.end = frame + afterFrames;
+            strcpy(request.name, "manual");
+            pending.push_back(request);
+        }
+
+        for(size_t i = 0; i < pending.size(); ) {
+            if(dump(pending[i], last)) {
+                pending.erase(pending.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+
+        if(last) {
+            break;
+        }
+    }
+}
+
+bool PreTriggerRecorder::copyFrames(uint64_t &begin, uint64_t &end)
+{
+    const uint64_t w = written.load(std::memory_order_acquire);
+    end = std::min(end, w);
+    begin = std::max(begin, w > capacity ? w - capacity : 0);
+    if(begin >= end) {
+        return false;
+    }
+
+    samples.resize(static_cast<size_t>(end - begin) * channels);
+    for(uint64_t frame = begin; frame < end; ) {
+        const size_t first = static_cast<size_t>(frame % capacity);
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(end - frame, capacity - first));
+        memcpy(&samples[static_cast<size_t>(frame - begin) * channels], &ring[first * channels], n * channels * sizeof(int16_t));
+        frame += n;
+    }
+
+    /* the start may have been overwritten meanwhile */
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t r = reserved.load(std::memory_order_relaxed);
+    const uint64_t valid = r > capacity ? r - capacity : 0;
+    if(valid >= end) {
+        return false;
+    }
+    if(valid > begin) {
+        samples.erase(samples.begin(), samples.begin() + static_cast<size_t>(valid - begin) * channels);
+        begin = valid;
+    }
+    return true;
+}
+
+std::string PreTriggerRecorder::nextPath(const char *name)
+{
+    char stamp[32];
+    const time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+
+    std::ostringstream path;
+    path << directory << "/whistle-" << stamp << "-" << ++sequence << "-" << name;
+    return path.str();
+}
+
+bool PreTriggerRecorder::dump(const DumpRequest &request, bool last)
+{
+    if(!last && written.load(std::memory_order_acquire) < request.end) {
+        return false;
+    }
+
+    uint64_t begin = request.begin, end = request.end;
+    if(!copyFrames(begin, end)) {
+        const short captured = otherChannels.load(std::memory_order_relaxed);
+        if(captured) {
+            std::cerr << captured << " channel(s) captured, the recorder was set up for " << channels << ", nothing is kept!" << std::endl;
+        } else {
+            std::cerr << "The audio of the " << request.name << " dump is no longer kept, skipped!" << std::endl;
+        }
+        return true;
+    }
+    if(begin > request.begin) {
+        std::cerr << "Warning: the " << request.name << " dump starts " << (begin - request.begin) * 1000 / sampleRate
+                  << " ms late, the writer fell behind." << std::endl;
+    }
+
+    const std::string path = nextPath(request.name);
+    const std::string wavPath = path + ".wav";
+    const int fd = ::open(wavPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        std::cerr << "cannot create " << wavPath << " (" << strerror(errno) << ")" << std::endl;
+        return true;
+    }
+
+    /* canonical 16 bit PCM header, the data straight behind it */
+    const uint32_t dataSize = static_cast<uint32_t>(samples.size() * sizeof(int16_t));
+    uint8_t header[WAV_HEADER_SIZE];
+    memcpy(header, "RIFF", 4);
+    writeLE32(header + 4, WAV_HEADER_SIZE - 8 + dataSize);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    writeLE32(header + 16, 16);
+    writeLE16(header + 20, 1);
+    writeLE16(header + 22, channels);
+    writeLE32(header + 24, sampleRate);
+    writeLE32(header + 28, sampleRate * channels * sizeof(int16_t));
+    writeLE16(header + 32, channels * sizeof(int16_t));
+    writeLE16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    writeLE32(header + 40, dataSize);
+
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = &samples[0];
+    iov[1].iov_len = dataSize;
+    const bool ok = writeAll(fd, iov, 2);
+    ::close(fd);
+    if(!ok) {
+        std::cerr << "cannot write " << wavPath << " (" << strerror(errno) << ")" << std::endl;
+        return true;
+    }
+
+    if(hasSpectra()) {
+        dumpSpectra(path + ".spec", begin, end);
+    }
+    ++dumps;
+    std::cout << "Dumped " << (end - begin) * 1000 / sampleRate << " ms of audio (" << request.name
+              << ") to " << wavPath << "." << std::endl;
+    return true;
+}
+
+void PreTriggerRecorder::dumpSpectra(const std::string &path, uint64_t begin, uint64_t end)
+{
+    SpectrogramWriter writer(path, SPECTROGRAM_FLOAT32, spectrumRate, windowSize, paddedSize, hop, 0, bins);
+    if(!writer.open()) {
+        return;
+    }
+
+    /* the spectra computed while the frames of the dump came in */
+    const uint64_t w = spectraWritten.load(std::memory_order_acquire);
+    for(uint64_t i = w > spectrumCapacity ? w - spectrumCapacity : 0; i < w; ++i) {
+        const size_t slot = static_cast<size_t>(i % spectrumCapacity);
+        const uint64_t frame = spectrumFrames[slot];
+        memcpy(&spectrum[0], &spectra[slot * bins], bins * sizeof(float));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(spectraReserved.load(std::memory_order_relaxed) > i + spectrumCapacity) {
+            continue;
+        }
+        if(frame > begin && frame <= end) {
+            writer.write(&spectrum[0], bins);
+        }
+    }
+    writer.close();
+}
@@ -0,0 +1,95 @@
+/*!
+ * \brief Keeps the last seconds of capture (and optionally the spectra) in memory and dumps the
+ *        audio around a whistle to disk from a writer thread, to look at false and missed whistles.
+ */
+
+#ifndef __AK_PRE_TRIGGER_RECORDER__
+#define __AK_PRE_TRIGGER_RECORDER__
+
+#include "EventDispatcher.h"
+#include "RingBuffer.h"
+#include <semaphore.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+class PreTriggerRecorder
+{
+public:
+    /* keeps seconds of captured frames; a dump holds before seconds up to the onset and after
+     * seconds past the detection, files go to directory */
+    PreTriggerRecorder(const std::string &directory, unsigned sampleRate, short channels,
+                       float seconds, float before, float after);
+    ~PreTriggerRecorder();
+
+    /* keeps the spectra of the windows as well, dumped as a spectrogram (see Spectrogram.h) */
+    void keepSpectra(unsigned spectrumRate, int windowSize, int paddedSize, int hop);
+    bool hasSpectra() const { return bins > 0; }
+    bool matchesSpectra(int windowSize, int paddedSize, int hop) const;
+
+    bool start();
+    /* dumps what is pending with the audio there is, then joins the thread */
+    void stop();
+
+    /* audio thread, never blocks, allocates or touches a file */
+    void write(const int16_t *data, int length, short channels);
+    void writeSpectrum(const float *spectrum, int length);
+    /* audio thread: dump around a detection, false if too many dumps are pending */
+    bool trigger(const WhistleEvent &event);
+
+    /* any other thread: dump around the current position */
+    void triggerNow();
+
+    unsigned long getDumps() const { return dumps; }
+    unsigned long getDropped() const { return dropped; }
+
+protected:
+    struct DumpRequest {
+        uint64_t begin, end;    /* captured frames */
+        char name[32];
+    };
+
+    void main();
+    /* true once written or no longer possible */
+    bool dump(const DumpRequest &request, bool last);
+    /* frames [begin, end) into samples as far as they are in the ring, narrows the range to them */
+    bool copyFrames(uint64_t &begin, uint64_t &end);
+    void dumpSpectra(const std::string &path, uint64_t begin, uint64_t end);
+    std::string nextPath(const char *name);
+
+    const std::string directory;
+    const unsigned sampleRate;
+    const short channels;
+    const uint64_t capacity, beforeFrames, afterFrames;
+
+    /* written by the audio thread only: the frames and spectra up to reserved are being
+     * overwritten, up to written they are complete (a seqlock per ring) */
+    std::vector<int16_t> ring;
+    std::atomic<uint64_t> reserved, written;
+
+    unsigned spectrumRate;
+    int windowSize, paddedSize, hop, bins;
+    uint64_t spectrumCapacity;
+    std::vector<float> spectra;
+    std::vector<uint64_t> spectrumFrames;   /* frames written when the spectrum was computed */
+    std::atomic<uint64_t> spectraReserved, spectraWritten;
+
+    RingBuffer<DumpRequest> requests;
+    std::atomic<uint64_t> manualFrame;
+    std::atomic<bool> manualPending;
+    sem_t semaphore;
+    std::atomic<bool> running;
+    std::thread thread;
+    std::atomic<unsigned long> dumps, dropped;
+    std::atomic<short> otherChannels;       /* channels of a capture that did not match, 0: none */
+
+    /* writer thread only */
+    std::vector<DumpRequest> pending;
+    std::vector<int16_t> samples;
+    std::vector<float> spectrum;
+    unsigned long sequence;
+};
+
+#endif
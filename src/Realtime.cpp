@@ -0,0 +1,50 @@
+/*!
+ * \brief Real-time scheduling helpers for the audio threads.
+ */
+
+#include "Realtime.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <cstring>
+#include <iostream>
+
+bool makeRealtime(const char *name, int priority, int cpu)
+{
+    bool ok = true;
+    int err;
+
+    if(priority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = priority;
+        if((err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) != 0) {
+            std::cerr << "cannot set SCHED_FIFO priority " << priority << " for " << name << " (" << strerror(err) << ")" << std::endl;
+            ok = false;
+        }
+    }
+
+    if(cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        if((err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) != 0) {
+            std::cerr << "cannot pin " << name << " to cpu " << cpu << " (" << strerror(err) << ")" << std::endl;
+            ok = false;
+        }
+    }
+
+    if(ok && (priority > 0 || cpu >= 0)) {
+        std::cout << name << ": priority " << priority << ", cpu " << cpu << std::endl;
+    }
+    return ok;
+}
+
+bool lockMemory()
+{
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        std::cerr << "cannot lock memory (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,15 @@
+/*!
+ * \brief Real-time scheduling helpers for the audio threads.
+ */
+
+#ifndef __AK_REALTIME__
+#define __AK_REALTIME__
+
+/* SCHED_FIFO with the given priority (0: leave the policy alone) and pinning to cpu (-1: any)
+ * for the calling thread, name is used for messages only */
+bool makeRealtime(const char *name, int priority, int cpu);
+
+/* locks all current and future pages of the process into memory */
+bool lockMemory();
+
+#endif
@@ -0,0 +1,93 @@
+/*!
+ * \brief Lock-free single producer / single consumer ring buffer.
+ */
+
+#ifndef __AK_RING_BUFFER__
+#define __AK_RING_BUFFER__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+template<typename T>
+class RingBuffer
+{
+public:
+    explicit RingBuffer(size_t capacity)
+        : buffer(capacity), capacity(capacity), head(0), tail(0)
+    {
+    }
+
+    size_t getCapacity() const { return capacity; }
+
+    /* number of elements the consumer can read */
+    size_t readable() const
+    {
+        return static_cast<size_t>(head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed));
+    }
+
+    /* producer: elements written so far, the position of the next one */
+    uint64_t written() const { return head.load(std::memory_order_relaxed); }
+    /* consumer: elements released so far, the position of the next one to read */
+    uint64_t consumed() const { return tail.load(std::memory_order_relaxed); }
+
+    /* producer: true once the consumer released everything written, its work on the elements
+     * is visible then */
+    bool drained() const
+    {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_relaxed);
+    }
+
+    /* producer: copies all n elements or nothing, never blocks */
+    bool write(const T *data, size_t n)
+    {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        if(capacity - static_cast<size_t>(h - tail.load(std::memory_order_acquire)) < n) {
+            return false;
+        }
+
+        const size_t begin = static_cast<size_t>(h % capacity);
+        const size_t first = std::min(n, capacity - begin);
+        std::memcpy(&buffer[begin], data, first * sizeof(T));
+        std::memcpy(&buffer[0], data + first, (n - first) * sizeof(T));
+
+        head.store(h + n, std::memory_order_release);
+        return true;
+    }
+
+    /* consumer: contiguous readable elements without copying, release them with consume() */
+    const T *peek(size_t &n) const
+    {
+        const uint64_t t = tail.load(std::memory_order_relaxed);
+        const size_t begin = static_cast<size_t>(t % capacity);
+        n = std::min(static_cast<size_t>(head.load(std::memory_order_acquire) - t), capacity - begin);
+        return &buffer[begin];
+    }
+
+    void consume(size_t n)
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    /* consumer: drops everything written so far */
+    void clear()
+    {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+protected:
+    std::vector<T> buffer;
+    const size_t capacity;
+
+    /* monotonic element counters (64 bit, they must not wrap), padded onto separate cache lines */
+    char padding0[64];
+    std::atomic<uint64_t> head;
+    char padding1[64];
+    std::atomic<uint64_t> tail;
+    char padding2[64];
+};
+
+#endif
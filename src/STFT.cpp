@@ -3,8 +3,10 @@
  * \author Thomas Hamboeck, Austrian Kangaroos 2014
  */
 #include "STFT.h"
+#include "Kernels.h"
+#include "Planner.h"
+#include "Timing.h"
 
-#include <limits>
 #include <complex>
 #include <iostream>
 
@@ -12,30 +14,40 @@
 
 STFT::STFT(const int channelOffset, const int windowTime, const int windowTimeStep, const int windowFrequency,
            std::function<void (const float *spectrum, int length)> handleSpectrum)
-    : offset(channelOffset),
-      windowTime(windowTime), windowTimeStep(windowTimeStep), windowFrequency(windowFrequency), windowFrequencyHalf(windowFrequency / 2 + 1),
+    : SlidingWindow(channelOffset, windowTime, windowTimeStep),
+      windowFrequency(windowFrequency), windowFrequencyHalf(windowFrequency / 2 + 1),
+      maxBatch(0),
       handleSpectrum(handleSpectrum),
-      nOverflow(0), overflownData(NULL), input(NULL), output(NULL), outputMag(NULL)
+      input(NULL), output(NULL), outputMag(NULL), plan(NULL)
 {
-    overflownData   = new int16_t[windowTime]; /* actually a max of (windowTime - 1) */
-    input           = static_cast<float*>(fftwf_malloc(sizeof(float) * windowFrequency));
-    output          = static_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * windowFrequencyHalf));
-    outputMag       = new float[windowFrequencyHalf];
-
-    WARN(windowFrequency >= windowTime, "Frequency window must be greater than Time Window.");
+    allocate();
+    plan = createPlan(1);
+    clearInput();
+}
 
-    for(int i = 0; i < windowFrequency; ++i) {
-        input[i] = 0.0f;
+STFT::STFT(const int channelOffset, const int windowTime, const int windowTimeStep, const int windowFrequency,
+           const int maxBatch, std::function<void (const float *spectra, int length, int count)> handleSpectra)
+    : SlidingWindow(channelOffset, windowTime, windowTimeStep),
+      windowFrequency(windowFrequency), windowFrequencyHalf(windowFrequency / 2 + 1),
+      maxBatch(maxBatch),
+      handleSpectra(handleSpectra),
+      input(NULL), output(NULL), outputMag(NULL), plan(NULL)
+{
+    WARN(maxBatch > 0, "Batch size must be positive.");
+    allocate();
+
+    batchPlans.resize(maxBatch + 1, NULL);
+    /* the full batch is the common case and worth measuring, partial batches at the end of a
+     * buffer are rare and estimated, all are planned here to keep the planner out of newData */
+    for(int count = 1; count < maxBatch; ++count) {
+        batchPlans[count] = planTransforms(windowFrequency, count, input, output, FFTW_ESTIMATE);
     }
-
-    plan = fftwf_plan_dft_r2c_1d(windowFrequency, input, output, FFTW_MEASURE);
+    batchPlans[maxBatch] = createPlan(maxBatch);
+    clearInput();
 }
 
 STFT::~STFT()
 {
-    if(overflownData) {
-        delete[] overflownData;
-    }
     if(input) {
         fftwf_free(input);
     }
@@ -45,63 +57,131 @@ STFT::~STFT()
     if(outputMag) {
         delete[] outputMag;
     }
+
     if(plan) {
-        fftwf_destroy_plan(plan);
+        destroyPlan(plan);
+    }
+    for(size_t i = 0; i < batchPlans.size(); ++i) {
+        if(batchPlans[i]) {
+            destroyPlan(batchPlans[i]);
+        }
     }
 }
 
-void STFT::intToFloat(const int16_t &in, float &out)
+void STFT::allocate()
 {
-    out = static_cast<float>(in) / (std::numeric_limits<int16_t>::max() + 1);
+    const int nWindows = isBatched() ? maxBatch : 1;
+
+    input           = static_cast<float*>(fftwf_malloc(sizeof(float) * windowFrequency * nWindows));
+    output          = static_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * windowFrequencyHalf * nWindows));
+    outputMag       = new float[windowFrequencyHalf * nWindows];
+
+    WARN(windowFrequency >= windowTime, "Frequency window must be greater than Time Window.");
 }
 
-void STFT::newData(const int16_t *data, int length, short channels)
+void STFT::clearInput()
 {
-    int iBegin, iEnd, iDataChannel, iBuffer;
+    /* after planning, FFTW_MEASURE overwrites the arrays; the padding stays zero from now on */
+    const int nWindows = isBatched() ? maxBatch : 1;
+    for(int i = 0; i < windowFrequency * nWindows; ++i) {
+        input[i] = 0.0f;
+    }
+}
 
-    iBuffer = 0;
+fftwf_plan STFT::createPlan(int count)
+{
+    return refiner.create(windowFrequency, count, input, output);
+}
 
-    /* for each overflown data */
-    while(iBuffer < nOverflow) {
-        intToFloat(overflownData[iBuffer], input[iBuffer]);
-        ++iBuffer;
+void STFT::adoptRefinedPlan()
+{
+    refiner.adopt(isBatched() ? batchPlans[maxBatch] : plan);
+}
+
+void STFT::addSpectrumTap(std::function<void (const float *spectrum, int length)> tap)
+{
+    spectrumTaps.push_back(tap);
+}
+
+void STFT::transform()
+{
+    {
+        StageTimer timer(TIMING_FFT);
+        fftwf_execute_dft_r2c(plan, input, output);
     }
 
-    iBegin = 0;
-    while(true) {
-        iEnd = iBegin + windowTimeStep;
-        if(iEnd > length) {
-            break;
-        }
+    /* calc magnitude */
+    {
+        StageTimer timer(TIMING_MAGNITUDE);
+        complexMagnitude(reinterpret_cast<const float*>(output), outputMag, windowFrequencyHalf);
+    }
+
+    for(size_t i = 0; i < spectrumTaps.size(); ++i) {
+        spectrumTaps[i](outputMag, windowFrequencyHalf);
+    }
+
+    StageTimer timer(TIMING_SPECTRUM);
+    handleSpectrum(outputMag, windowFrequencyHalf);
+}
 
-        iDataChannel = iBegin * channels + offset;
-        while(iBuffer < windowTime) {
-            intToFloat(data[iDataChannel], input[iBuffer]);
-            ++iBuffer;
-            iDataChannel += channels;
+void STFT::transformBatch(int count)
+{
+    {
+        StageTimer timer(TIMING_FFT);
+        fftwf_execute_dft_r2c(batchPlans[count], input, output);
+    }
+
+    /* calc magnitude of all spectra at once, they are contiguous */
+    {
+        StageTimer timer(TIMING_MAGNITUDE);
+        complexMagnitude(reinterpret_cast<const float*>(output), outputMag, windowFrequencyHalf * count);
+    }
+
+    for(size_t i = 0; i < spectrumTaps.size(); ++i) {
+        for(int j = 0; j < count; ++j) {
+            spectrumTaps[i](outputMag + j * windowFrequencyHalf, windowFrequencyHalf);
         }
-        /* and the rest is zero */
+    }
 
-        fftwf_execute(plan);
+    StageTimer timer(TIMING_SPECTRUM);
+    handleSpectra(outputMag, windowFrequencyHalf, count);
+}
 
-        /* calc magnitude */
-        for(int i = 0; i < windowFrequencyHalf; ++i) {
-            outputMag[i] = std::abs(*reinterpret_cast<std::complex<float>* >(&output[i]));
+void STFT::newData(const int16_t *data, int length, short channels)
+{
+    adoptRefinedPlan();
+    skipData(data, length, channels);
+
+    /* windows start every windowTimeStep samples of the stream: overflown data followed by data */
+    const int total = streamLength(length);
+    int iBegin = 0;
+    int nBatch = 0;
+
+    while(iBegin + windowTime <= total) {
+        if(isBatched()) {
+            {
+                StageTimer timer(TIMING_CONVERT);
+                fillWindow(input + nBatch * windowFrequency, data, iBegin, channels);
+            }
+            if(++nBatch == maxBatch) {
+                transformBatch(nBatch);
+                nBatch = 0;
+            }
+        } else {
+            {
+                StageTimer timer(TIMING_CONVERT);
+                fillWindow(input, data, iBegin, channels);
+            }
+            transform();
         }
-        handleSpectrum(outputMag, windowFrequencyHalf);
 
         /* next cycle */
-        iBuffer = 0;
-        iBegin  += windowTimeStep;
+        iBegin += windowTimeStep;
     }
 
-    nOverflow = 0;
-    iDataChannel = iBegin * channels + offset;
-    while(iBegin < length) {
-        /* copy to overflow buffer */
-        overflownData[nOverflow] = data[iDataChannel];
-        ++nOverflow;
-        ++iBegin;
-        iDataChannel += channels;
+    if(nBatch > 0) {
+        transformBatch(nBatch);
     }
+
+    keepOverflow(data, length, iBegin, channels);
 }
@@ -6,33 +6,58 @@
 #ifndef __AK_STFT__
 #define __AK_STFT__
 
+#include "Planner.h"
+#include "SlidingWindow.h"
 #include <fftw3.h>
 #include <complex>
 #include <functional>
+#include <vector>
 
-class STFT
+class STFT : public SlidingWindow
 {
 public:
+    /* one transform and one handler call per window */
     STFT(const int channelOffset, const int windowTime, const int windowTimeStep, const int windowFrequency,
          std::function<void (const float *spectrum, int length)> handleSpectrum);
+    /* batched: all complete windows of a buffer (at most maxBatch) are transformed at once,
+     * the handler gets count consecutive spectra of length bins each */
+    STFT(const int channelOffset, const int windowTime, const int windowTimeStep, const int windowFrequency,
+         const int maxBatch, std::function<void (const float *spectra, int length, int count)> handleSpectra);
     virtual ~STFT();
 
     void newData(const int16_t *data, int length, short channels);
 
+    bool isBatched() const { return maxBatch > 0; }
+
+    /* gets every magnitude spectrum before the handler, one call per window also when batched */
+    void addSpectrumTap(std::function<void (const float *spectrum, int length)> tap);
+
 protected:
-    void intToFloat(const int16_t &in, float &out);
+    void allocate();
+    void clearInput();
 
-    const int offset;
-    const int windowTime, windowTimeStep, windowFrequency, windowFrequencyHalf;
+    /* from wisdom, otherwise estimated and measured in the background (see Planner.h) */
+    fftwf_plan createPlan(int count);
+    /* swaps in the measured plan, called by the processing thread */
+    void adoptRefinedPlan();
+
+    void transform();
+    void transformBatch(int count);
+
+    const int windowFrequency, windowFrequencyHalf;
+    const int maxBatch;
     std::function<void (const float *spectrum, int length)> handleSpectrum;
+    std::function<void (const float *spectra, int length, int count)> handleSpectra;
+    std::vector<std::function<void (const float *spectrum, int length)> > spectrumTaps;
 
-    int nOverflow;
-    int16_t *overflownData;
     float *input;
     fftwf_complex *output;
     float *outputMag;
 
     fftwf_plan plan;
+    std::vector<fftwf_plan> batchPlans; /* indexed by number of windows */
+
+    PlanRefiner refiner;
 };
 
 #endif
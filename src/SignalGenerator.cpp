@@ -0,0 +1,142 @@
+/*!
+ * \brief Deterministic synthetic test signals: whistles with frequency sweep, crowd noise,
+ *        clipping and several channels.
+ */
+
+#include "SignalGenerator.h"
+#include <algorithm>
+#include <cmath>
+
+#define RAMP_TIME       (0.01f)     /* fade in and out of tones in s */
+
+SignalGenerator::SignalGenerator(unsigned sampleRate, short channels, long frames, uint32_t seed)
+    : sampleRate(sampleRate), channels(channels), frames(frames), state(seed ? seed : 1),
+      gains(channels, 1.0f), delays(channels, 0), signal(static_cast<size_t>(frames) * channels, 0.0f)
+{
+}
+
+void SignalGenerator::setChannel(short channel, float gain, int delayFrames)
+{
+    gains[channel]  = gain;
+    delays[channel] = delayFrames;
+}
+
+float SignalGenerator::uniform()
+{
+    /* xorshift32 */
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return static_cast<float>(state) / 2147483648.0f - 1.0f;
+}
+
+void SignalGenerator::addSource(const std::vector<float> &source)
+{
+    for(short c = 0; c < channels; ++c) {
+        for(long i = delays[c]; i < frames; ++i) {
+            signal[i * channels + c] += gains[c] * source[i - delays[c]];
+        }
+    }
+}
+
+void SignalGenerator::addTone(float fBegin, float fEnd, float amplitude, float start, float duration)
+{
+    std::vector<float> source(frames, 0.0f);
+
+    const long iBegin = std::max(0L, static_cast<long>(start * sampleRate));
+    const long iEnd   = std::min(frames, static_cast<long>((start + duration) * sampleRate));
+    const long nRamp  = static_cast<long>(RAMP_TIME * sampleRate);
+    const long length = static_cast<long>(duration * sampleRate);
+
+    double phase = 0.0;
+    for(long i = iBegin; i < iEnd; ++i) {
+        const long t = i - iBegin;
+        const double f = fBegin + (fEnd - fBegin) * static_cast<double>(t) / length;
+        phase += 2.0 * M_PI * f / sampleRate;
+
+        float envelope = 1.0f;
+        if(t < nRamp) {
+            envelope = static_cast<float>(t) / nRamp;
+        } else if(length - t < nRamp) {
+            envelope = static_cast<float>(length - t) / nRamp;
+        }
+        source[i] = amplitude * envelope * static_cast<float>(std::sin(phase));
+    }
+    addSource(source);
+}
+
+void SignalGenerator::addNoise(float amplitude)
+{
+    /* uniform noise has a deviation of 1 / sqrt(3) */
+    const float scale = amplitude * std::sqrt(3.0f);
+    for(size_t i = 0; i < signal.size(); ++i) {
+        signal[i] += scale * uniform();
+    }
+}
+
+void SignalGenerator::addCrowd(float amplitude, int voices)
+{
+    std::vector<float> source(frames, 0.0f);
+    std::vector<float> voice(frames);
+
+    for(int v = 0; v < voices; ++v) {
+        /* noise through a resonator at a formant like frequency */
+        const double f     = 300.0 + 1350.0 * (uniform() + 1.0f);
+        const double r     = std::exp(-M_PI * 200.0 / sampleRate);
+        const double a1    = 2.0 * r * std::cos(2.0 * M_PI * f / sampleRate);
+        const double a2    = -r * r;
+        /* syllables at 3 to 6 Hz */
+        const double rate  = 4.5 + 1.5 * uniform();
+        const double shift = M_PI * uniform();
+
+        double y1 = 0.0, y2 = 0.0, energy = 0.0;
+        for(long i = 0; i < frames; ++i) {
+            const double y = uniform() + a1 * y1 + a2 * y2;
+            y2 = y1;
+            y1 = y;
+            const double s = std::sin(2.0 * M_PI * rate * i / sampleRate + shift);
+            voice[i] = static_cast<float>(y * s * s);
+            energy += voice[i] * voice[i];
+        }
+
+        /* every voice contributes the same power */
+        const float scale = energy > 0.0 ? static_cast<float>(std::sqrt(frames / energy / voices)) : 0.0f;
+        for(long i = 0; i < frames; ++i) {
+            source[i] += scale * voice[i];
+        }
+    }
+
+    /* pink background, Paul Kellet's economy filter, about a third of the babble */
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0, energy = 0.0;
+    for(long i = 0; i < frames; ++i) {
+        const double white = uniform();
+        b0 = 0.99765 * b0 + white * 0.0990460;
+        b1 = 0.96300 * b1 + white * 0.2965164;
+        b2 = 0.57000 * b2 + white * 1.0526913;
+        voice[i] = static_cast<float>(b0 + b1 + b2 + white * 0.1848);
+        energy += voice[i] * voice[i];
+    }
+    const float pinkScale = energy > 0.0 ? static_cast<float>(std::sqrt(frames / energy) / 3.0) : 0.0f;
+
+    for(long i = 0; i < frames; ++i) {
+        source[i] = amplitude * (source[i] + pinkScale * voice[i]);
+    }
+    addSource(source);
+}
+
+void SignalGenerator::clip(float level)
+{
+    for(size_t i = 0; i < signal.size(); ++i) {
+        signal[i] = std::max(-level, std::min(level, signal[i]));
+    }
+}
+
+std::vector<int16_t> SignalGenerator::render() const
+{
+    std::vector<int16_t> samples(signal.size());
+    for(size_t i = 0; i < signal.size(); ++i) {
+        const float s = std::round(signal[i] * 32768.0f);
+        samples[i] = static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, s)));
+    }
+    return samples;
+}
@@ -0,0 +1,53 @@
+/*!
+ * \brief Deterministic synthetic test signals: whistles with frequency sweep, crowd noise,
+ *        clipping and several channels.
+ */
+
+#ifndef __AK_SIGNAL_GENERATOR__
+#define __AK_SIGNAL_GENERATOR__
+
+#include <cstdint>
+#include <vector>
+
+class SignalGenerator
+{
+public:
+    /* the same seed always gives the same signal */
+    SignalGenerator(unsigned sampleRate, short channels, long frames, uint32_t seed = 1);
+
+    /* gain and delay of a channel relative to the source, applied to everything added afterwards */
+    void setChannel(short channel, float gain, int delayFrames);
+
+    /* amplitude relative to full scale, frequency sweeps linearly from fBegin to fEnd, times in s */
+    void addTone(float fBegin, float fEnd, float amplitude, float start, float duration);
+    /* white noise, independent per channel */
+    void addNoise(float amplitude);
+    /* babble of a number of voices (resonant noise with syllable envelopes) over pink noise */
+    void addCrowd(float amplitude, int voices = 8);
+    /* hard clipping of everything added so far at level (relative to full scale) */
+    void clip(float level);
+
+    /* interleaved S16, saturated */
+    std::vector<int16_t> render() const;
+
+    unsigned getSampleRate() const { return sampleRate; }
+    short getChannels() const { return channels; }
+    long getFrames() const { return frames; }
+
+protected:
+    /* uniform in [-1, 1) */
+    float uniform();
+    /* adds a mono source to all channels with their gain and delay */
+    void addSource(const std::vector<float> &source);
+
+    const unsigned sampleRate;
+    const short channels;
+    const long frames;
+
+    uint32_t state;
+    std::vector<float> gains;
+    std::vector<int> delays;
+    std::vector<float> signal;  /* interleaved */
+};
+
+#endif
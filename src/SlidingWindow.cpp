@@ -0,0 +1,93 @@
+/*!
+ * \brief Cuts a stream of interleaved sound buffers into overlapping windows of one channel.
+ */
+
+#include "SlidingWindow.h"
+#include "Kernels.h"
+
+#include <algorithm>
+
+SlidingWindow::SlidingWindow(const int channelOffset, const int windowTime, const int windowTimeStep)
+    : offset(channelOffset), windowTime(windowTime), windowTimeStep(windowTimeStep),
+      nOverflow(0), nSkip(0), overflownData(NULL)
+{
+    overflownData = new int16_t[windowTime]; /* actually a max of (windowTime - 1) */
+}
+
+SlidingWindow::~SlidingWindow()
+{
+    if(overflownData) {
+        delete[] overflownData;
+    }
+}
+
+void SlidingWindow::restart()
+{
+    nOverflow = 0;
+    nSkip = 0;
+}
+
+void SlidingWindow::skipData(const int16_t *&data, int &length, short channels)
+{
+    if(nSkip > 0) {
+        const int skipped = std::min(nSkip, length);
+        data   += skipped * channels;
+        length -= skipped;
+        nSkip  -= skipped;
+    }
+}
+
+void SlidingWindow::fillWindow(float *window, const int16_t *data, int iBegin, short channels)
+{
+    int iBuffer = 0;
+
+    /* for each overflown data */
+    if(iBegin < nOverflow) {
+        iBuffer = std::min(nOverflow - iBegin, windowTime);
+        convertInt16(overflownData + iBegin, 1, window, iBuffer);
+        iBegin += iBuffer;
+    }
+
+    convertInt16(data + (iBegin - nOverflow) * channels + offset, channels, window + iBuffer, windowTime - iBuffer);
+    /* and the rest is zero */
+}
+
+void SlidingWindow::fillWindowInt16(int16_t *window, const int16_t *data, int iBegin, short channels)
+{
+    int iWindow = 0;
+    while(iBegin < nOverflow && iWindow < windowTime) {
+        window[iWindow++] = overflownData[iBegin++];
+    }
+
+    const int16_t *sample = data + (iBegin - nOverflow) * channels + offset;
+    for(; iWindow < windowTime; ++iWindow) {
+        window[iWindow] = *sample;
+        sample += channels;
+    }
+}
+
+void SlidingWindow::keepOverflow(const int16_t *data, int length, int iBegin, short channels)
+{
+    const int total = nOverflow + length;
+    if(iBegin >= total) {
+        /* the window step is larger than the window, drop the gap */
+        nSkip += iBegin - total;
+        nOverflow = 0;
+        return;
+    }
+
+    int nKept = 0;
+    /* still needed overflown data (only for buffers shorter than a window) */
+    while(iBegin < nOverflow) {
+        overflownData[nKept++] = overflownData[iBegin++];
+    }
+
+    int iDataChannel = (iBegin - nOverflow) * channels + offset;
+    while(iBegin < total) {
+        /* copy to overflow buffer */
+        overflownData[nKept++] = data[iDataChannel];
+        ++iBegin;
+        iDataChannel += channels;
+    }
+    nOverflow = nKept;
+}
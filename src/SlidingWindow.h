@@ -0,0 +1,38 @@
+/*!
+ * \brief Cuts a stream of interleaved sound buffers into overlapping windows of one channel.
+ */
+
+#ifndef __AK_SLIDING_WINDOW__
+#define __AK_SLIDING_WINDOW__
+
+#include <cstdint>
+
+class SlidingWindow
+{
+public:
+    SlidingWindow(const int channelOffset, const int windowTime, const int windowTimeStep);
+    virtual ~SlidingWindow();
+
+    /* forgets the samples kept from earlier buffers, the next buffer starts a new stream */
+    void restart();
+
+protected:
+    /* drops samples of a gap between windows (window step larger than window) */
+    void skipData(const int16_t *&data, int &length, short channels);
+    /* number of samples in the stream: overflown data followed by data */
+    int streamLength(int length) const { return nOverflow + length; }
+    /* copies the window starting at stream position iBegin, converted to float */
+    void fillWindow(float *window, const int16_t *data, int iBegin, short channels);
+    /* the same window as it was recorded */
+    void fillWindowInt16(int16_t *window, const int16_t *data, int iBegin, short channels);
+    /* keeps the samples from stream position iBegin on for the next buffer */
+    void keepOverflow(const int16_t *data, int length, int iBegin, short channels);
+
+    const int offset;
+    const int windowTime, windowTimeStep;
+
+    int nOverflow, nSkip;
+    int16_t *overflownData;
+};
+
+#endif
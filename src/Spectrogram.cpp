@@ -0,0 +1,342 @@
+/*!
+ * \brief On-disk spectrogram cache: a header followed by fixed size magnitude frames (float or
+ *        float16, optionally only a bin range), written by a tap on STFT and memory mapped for replay.
+ */
+
+#include "Spectrogram.h"
+#include "Kernels.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#define WRITE_BUFFER_SIZE   (1 << 16)
+
+static_assert(sizeof(SpectrogramHeader) == 64, "the header layout is part of the file format");
+
+/* IEEE 754 binary16, round to nearest even, no infinities or NaNs expected for magnitudes */
+static uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const int exponent  = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa   = bits & 0x7fffff;
+
+    if(exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7bff);    /* saturate at the largest finite value */
+    }
+    if(exponent <= 0) {
+        if(exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        /* subnormal */
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if(rest > halfway || (rest == halfway && (half & 1))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1fff;
+    if(rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        ++half;     /* may carry into the exponent, which is still correct */
+    }
+    if(half >= 0x7c00) {
+        half = 0x7bff;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+static float halfToFloat(uint16_t half)
+{
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+
+    if(exponent == 0) {
+        if(mantissa == 0) {
+            bits = sign;
+        } else {
+            /* normalize the subnormal */
+            int e = -1;
+            do {
+                ++e;
+                mantissa <<= 1;
+            } while(!(mantissa & 0x400));
+            bits = sign | (static_cast<uint32_t>(127 - 15 - e) << 23) | ((mantissa & 0x3ff) << 13);
+        }
+    } else if(exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/*******************************************************************/
+SpectrogramWriter::SpectrogramWriter(const std::string &path, SpectrogramFormat format, unsigned sampleRate,
+                                     int windowSize, int paddedSize, int hop, int binBegin, int binEnd)
+    : path(path), fd(-1), used(0)
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SPECTROGRAM_MAGIC, sizeof(header.magic));
+    header.format       = format;
+    header.sampleRate   = sampleRate;
+    header.windowSize   = windowSize;
+    header.paddedSize   = paddedSize;
+    header.hop          = hop;
+    header.binBegin     = binBegin;
+    header.binEnd       = binEnd;
+
+    const size_t bytes  = (format == SPECTROGRAM_FLOAT16 ? sizeof(uint16_t) : sizeof(float)) * (binEnd - binBegin);
+    header.frameSize    = static_cast<uint32_t>(2 * sizeof(float) + ((bytes + 3) & ~static_cast<size_t>(3)));
+    header.frames       = 0;
+}
+
+SpectrogramWriter::~SpectrogramWriter()
+{
+    close();
+}
+
+bool SpectrogramWriter::open()
+{
+    if(fd >= 0) {
+        std::cerr << "Double initialization" << std::endl;
+        return false;
+    }
+    if(header.binBegin >= header.binEnd || header.binEnd > header.paddedSize / 2 + 1) {
+        std::cerr << "invalid bin range " << header.binBegin << " - " << header.binEnd << " for spectrogram " << path << std::endl;
+        return false;
+    }
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        std::cerr << "cannot create spectrogram " << path << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    if(::write(fd, &header, sizeof(header)) != static_cast<ssize_t>(sizeof(header))) {
+        std::cerr << "cannot write spectrogram header to " << path << std::endl;
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    buffer.assign(std::max<size_t>(WRITE_BUFFER_SIZE, header.frameSize), 0);
+    used = 0;
+    return true;
+}
+
+void SpectrogramWriter::write(const float *spectrum, int length)
+{
+    if(fd < 0 || length < static_cast<int>(header.binEnd)) {
+        return;
+    }
+    if(used + header.frameSize > buffer.size()) {
+        flush();
+    }
+
+    uint8_t *frame = &buffer[used];
+    memset(frame, 0, header.frameSize);
+
+    float stats[2];
+    meanDeviation(spectrum, length, stats[0], stats[1]);
+    memcpy(frame, stats, sizeof(stats));
+
+    const float *bins = spectrum + header.binBegin;
+    const int nBins = static_cast<int>(header.binEnd - header.binBegin);
+    if(header.format == SPECTROGRAM_FLOAT16) {
+        uint16_t *out = reinterpret_cast<uint16_t*>(frame + sizeof(stats));
+        for(int i = 0; i < nBins; ++i) {
+            out[i] = floatToHalf(bins[i]);
+        }
+    } else {
+        memcpy(frame + sizeof(stats), bins, nBins * sizeof(float));
+    }
+
+    used += header.frameSize;
+    ++header.frames;
+}
+
+void SpectrogramWriter::flush()
+{
+    size_t done = 0;
+    while(done < used) {
+        const ssize_t n = ::write(fd, &buffer[done], used - done);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            std::cerr << "cannot write spectrogram " << path << " (" << strerror(errno) << ")" << std::endl;
+            break;
+        }
+        done += n;
+    }
+    used = 0;
+}
+
+void SpectrogramWriter::close()
+{
+    if(fd < 0) {
+        return;
+    }
+    flush();
+    if(pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+        std::cerr << "cannot update spectrogram header of " << path << std::endl;
+    }
+    ::close(fd);
+    fd = -1;
+}
+
+/*******************************************************************/
+SpectrogramReader::SpectrogramReader(const std::string &path)
+    : path(path), fd(-1), mapping(NULL), mappingSize(0), header(NULL), nFrames(0)
+{
+}
+
+SpectrogramReader::~SpectrogramReader()
+{
+    close();
+}
+
+bool SpectrogramReader::isSpectrogram(const std::string &path)
+{
+    char magic[8];
+    const int f = ::open(path.c_str(), O_RDONLY);
+    if(f < 0) {
+        return false;
+    }
+    const bool match = ::read(f, magic, sizeof(magic)) == static_cast<ssize_t>(sizeof(magic))
+                       && memcmp(magic, SPECTROGRAM_MAGIC, sizeof(magic)) == 0;
+    ::close(f);
+    return match;
+}
+
+bool SpectrogramReader::open()
+{
+    if(mapping) {
+        std::cerr << "Double initialization" << std::endl;
+        return false;
+    }
+
+    fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cerr << "cannot open spectrogram " << path << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(SpectrogramHeader)) {
+        std::cerr << "spectrogram " << path << " is truncated" << std::endl;
+        close();
+        return false;
+    }
+    mappingSize = static_cast<size_t>(st.st_size);
+
+    void *addr = mmap(NULL, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(addr == MAP_FAILED) {
+        std::cerr << "cannot map spectrogram " << path << " (" << strerror(errno) << ")" << std::endl;
+        mappingSize = 0;
+        close();
+        return false;
+    }
+    mapping = static_cast<const uint8_t*>(addr);
+    madvise(addr, mappingSize, MADV_SEQUENTIAL);
+    header = reinterpret_cast<const SpectrogramHeader*>(mapping);
+
+    const size_t binBytes = header->format == SPECTROGRAM_FLOAT16 ? sizeof(uint16_t) : sizeof(float);
+    if(memcmp(header->magic, SPECTROGRAM_MAGIC, sizeof(header->magic)) != 0
+       || header->format > SPECTROGRAM_FLOAT16 || header->binBegin >= header->binEnd
+       || header->frameSize < 2 * sizeof(float) + binBytes * (header->binEnd - header->binBegin)) {
+        std::cerr << path << " is not a valid spectrogram" << std::endl;
+        close();
+        return false;
+    }
+
+    /* a writer that was killed never updated the frame count, use what is there */
+    const uint64_t available = (mappingSize - sizeof(SpectrogramHeader)) / header->frameSize;
+    nFrames = (header->frames && header->frames <= available) ? header->frames : available;
+
+    std::cout << "Replaying spectrogram " << path << ": " << nFrames << " frames of bins " << header->binBegin
+              << " - " << header->binEnd << " (" << header->paddedSize << " point transform, hop "
+              << header->hop << ", " << header->sampleRate << " Hz)." << std::endl;
+    return true;
+}
+
+void SpectrogramReader::close()
+{
+    if(mapping) {
+        munmap(const_cast<uint8_t*>(mapping), mappingSize);
+        mapping = NULL;
+        mappingSize = 0;
+    }
+    if(fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    header = NULL;
+    nFrames = 0;
+}
+
+const uint8_t *SpectrogramReader::frameData(uint64_t frame) const
+{
+    return mapping + sizeof(SpectrogramHeader) + frame * header->frameSize;
+}
+
+float SpectrogramReader::getMean(uint64_t frame) const
+{
+    return reinterpret_cast<const float*>(frameData(frame))[0];
+}
+
+float SpectrogramReader::getDeviation(uint64_t frame) const
+{
+    return reinterpret_cast<const float*>(frameData(frame))[1];
+}
+
+const float *SpectrogramReader::getMagnitudes(uint64_t frame) const
+{
+    if(header->format != SPECTROGRAM_FLOAT32) {
+        return NULL;
+    }
+    return reinterpret_cast<const float*>(frameData(frame)) + 2;
+}
+
+void SpectrogramReader::readMagnitudes(uint64_t frame, float *out) const
+{
+    const int nBins = getBins();
+    if(header->format == SPECTROGRAM_FLOAT32) {
+        memcpy(out, getMagnitudes(frame), nBins * sizeof(float));
+    } else {
+        const uint16_t *in = reinterpret_cast<const uint16_t*>(frameData(frame) + 2 * sizeof(float));
+        for(int i = 0; i < nBins; ++i) {
+            out[i] = halfToFloat(in[i]);
+        }
+    }
+}
+
+void SpectrogramReader::replay(std::function<void (const float *band, int length, float mean, float dev)> handler) const
+{
+    const int nBins = getBins();
+    std::vector<float> decoded(header->format == SPECTROGRAM_FLOAT32 ? 0 : nBins);
+
+    for(uint64_t i = 0; i < nFrames; ++i) {
+        const float *band = getMagnitudes(i);
+        if(!band) {
+            readMagnitudes(i, decoded.data());
+            band = decoded.data();
+        }
+        handler(band, nBins, getMean(i), getDeviation(i));
+    }
+}
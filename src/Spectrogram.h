@@ -0,0 +1,105 @@
+/*!
+ * \brief On-disk spectrogram cache: a header followed by fixed size magnitude frames (float or
+ *        float16, optionally only a bin range), written by a tap on STFT and memory mapped for replay.
+ *
+ * Layout (little endian):
+ *   SpectrogramHeader
+ *   frames: mean and deviation of the full spectrum (2 x float), magnitudes of bins
+ *           [binBegin, binEnd), padded to a multiple of 4 bytes
+ */
+
+#ifndef __AK_SPECTROGRAM__
+#define __AK_SPECTROGRAM__
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#define SPECTROGRAM_MAGIC       "AKSPEC01"
+
+enum SpectrogramFormat {
+    SPECTROGRAM_FLOAT32 = 0,
+    SPECTROGRAM_FLOAT16 = 1
+};
+
+struct SpectrogramHeader
+{
+    char magic[8];
+    uint32_t format;            /* SpectrogramFormat */
+    uint32_t sampleRate;
+    uint32_t windowSize;        /* samples per window */
+    uint32_t paddedSize;        /* transform size, the full spectrum has paddedSize / 2 + 1 bins */
+    uint32_t hop;               /* samples between windows */
+    uint32_t binBegin, binEnd;  /* stored bins */
+    uint32_t frameSize;         /* bytes per frame */
+    uint64_t frames;
+    uint8_t reserved[16];
+};
+
+class SpectrogramWriter
+{
+public:
+    /* stores bins [binBegin, binEnd) of spectra with paddedSize / 2 + 1 bins */
+    SpectrogramWriter(const std::string &path, SpectrogramFormat format, unsigned sampleRate,
+                      int windowSize, int paddedSize, int hop, int binBegin, int binEnd);
+    ~SpectrogramWriter();
+
+    bool open();
+    /* full magnitude spectrum, see STFT::addSpectrumTap */
+    void write(const float *spectrum, int length);
+    /* flushes and writes the number of frames into the header */
+    void close();
+
+    const SpectrogramHeader &getHeader() const { return header; }
+    uint64_t getFrames() const { return header.frames; }
+
+protected:
+    void flush();
+
+    const std::string path;
+    SpectrogramHeader header;
+    int fd;
+    std::vector<uint8_t> buffer;
+    size_t used;
+};
+
+class SpectrogramReader
+{
+public:
+    explicit SpectrogramReader(const std::string &path);
+    ~SpectrogramReader();
+
+    /* maps the file and checks the header */
+    bool open();
+    void close();
+
+    const SpectrogramHeader &getHeader() const { return *header; }
+    uint64_t getFrames() const { return nFrames; }
+    int getBins() const { return static_cast<int>(header->binEnd - header->binBegin); }
+
+    float getMean(uint64_t frame) const;
+    float getDeviation(uint64_t frame) const;
+    /* the stored magnitudes without copying, float32 files only (NULL otherwise) */
+    const float *getMagnitudes(uint64_t frame) const;
+    /* the stored magnitudes converted to float */
+    void readMagnitudes(uint64_t frame, float *out) const;
+
+    /* all frames in order: stored magnitudes (bin binBegin first), count, spectrum mean and deviation */
+    void replay(std::function<void (const float *band, int length, float mean, float dev)> handler) const;
+
+    /* true if the file starts with the spectrogram magic */
+    static bool isSpectrogram(const std::string &path);
+
+protected:
+    const uint8_t *frameData(uint64_t frame) const;
+
+    const std::string path;
+    int fd;
+    const uint8_t *mapping;
+    size_t mappingSize;
+    const SpectrogramHeader *header;
+    uint64_t nFrames;
+};
+
+#endif
@@ -0,0 +1,265 @@
+/*!
+ * \brief Live magnitude spectra for other processes (visualizer, localization, debugging) in a
+ *        POSIX shared memory ring: one publisher on the audio thread, any number of readers.
+ */
+
+#include "SpectrumShm.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+static_assert(sizeof(SpectrumShmHeader) == 128, "the header is part of the shared layout");
+static_assert(sizeof(SpectrumSlot) == 32, "the slot header is part of the shared layout");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "readers of other processes need lock free 32 bit atomics");
+
+#define SPECTRUM_SLOT_ALIGNMENT     (64)    /* a cache line per slot at least */
+
+/*******************************************************************/
+SpectrumPublisher::SpectrumPublisher(const std::string &name, unsigned sampleRate, int windowSize, int paddedSize,
+                                     int hop, int slots)
+    : name(name), memory(NULL), size(0), published(0), timestamp(0), flags(0)
+{
+    memset(static_cast<void*>(&layout), 0, sizeof(layout));
+    memcpy(layout.magic, SPECTRUM_SHM_MAGIC, sizeof(layout.magic));
+    layout.sampleRate   = sampleRate;
+    layout.windowSize   = windowSize;
+    layout.paddedSize   = paddedSize;
+    layout.hop          = hop;
+    layout.bins         = paddedSize / 2 + 1;
+    layout.slots        = 1;
+    while(layout.slots < static_cast<uint32_t>(slots)) {
+        layout.slots *= 2;
+    }
+    const size_t bytes  = sizeof(SpectrumSlot) + layout.bins * sizeof(float);
+    layout.slotSize     = static_cast<uint32_t>((bytes + SPECTRUM_SLOT_ALIGNMENT - 1) & ~static_cast<size_t>(SPECTRUM_SLOT_ALIGNMENT - 1));
+    layout.pid          = static_cast<uint32_t>(getpid());
+}
+
+SpectrumPublisher::~SpectrumPublisher()
+{
+    close();
+}
+
+bool SpectrumPublisher::open()
+{
+    if(memory) {
+        std::cerr << "Double initialization" << std::endl;
+        return false;
+    }
+
+    /* a ring of an earlier run may still be mapped by readers, they notice it stopped */
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0) {
+        std::cerr << "cannot create shared memory " << name << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    size = sizeof(SpectrumShmHeader) + static_cast<size_t>(layout.slots) * layout.slotSize;
+    void *mapped = MAP_FAILED;
+    if(ftruncate(fd, size) == 0) {
+        mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if(mapped == MAP_FAILED) {
+        std::cerr << "cannot map shared memory " << name << " (" << strerror(errno) << ")" << std::endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+    memory = static_cast<uint8_t*>(mapped);
+
+    /* touches every page, publishing never faults; the magic goes in last */
+    memset(memory, 0, size);
+    SpectrumShmHeader *header = reinterpret_cast<SpectrumShmHeader*>(memory);
+    memcpy(static_cast<void*>(header), &layout, offsetof(SpectrumShmHeader, published));
+    memset(header->magic, 0, sizeof(header->magic));
+    header->published.store(0, std::memory_order_relaxed);
+    header->publishing.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, SPECTRUM_SHM_MAGIC, sizeof(header->magic));
+    published = 0;
+    return true;
+}
+
+void SpectrumPublisher::close()
+{
+    if(!memory) {
+        return;
+    }
+    reinterpret_cast<SpectrumShmHeader*>(memory)->publishing.store(0, std::memory_order_release);
+    munmap(memory, size);
+    memory = NULL;
+    shm_unlink(name.c_str());
+}
+
+bool SpectrumPublisher::matches(int windowSize, int paddedSize, int hop) const
+{
+    return static_cast<uint32_t>(windowSize) == layout.windowSize && static_cast<uint32_t>(paddedSize) == layout.paddedSize
+           && static_cast<uint32_t>(hop) == layout.hop;
+}
+
+void SpectrumPublisher::publish(const float *spectrum, int length)
+{
+    if(!memory) {
+        return;
+    }
+    SpectrumShmHeader *header = reinterpret_cast<SpectrumShmHeader*>(memory);
+    SpectrumSlot *slot = reinterpret_cast<SpectrumSlot*>(memory + sizeof(SpectrumShmHeader)
+                                                         + (published & (layout.slots - 1)) * layout.slotSize);
+    const uint32_t bins = std::min(static_cast<uint32_t>(length), layout.bins);
+    const uint32_t lock = static_cast<uint32_t>(2 * published);
+
+    slot->lock.store(lock + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->bins      = bins;
+    slot->sequence  = published;
+    slot->timestamp = timestamp;
+    slot->flags     = flags;
+    memcpy(reinterpret_cast<float*>(slot + 1), spectrum, bins * sizeof(float));
+    slot->lock.store(lock + 2, std::memory_order_release);
+
+    ++published;
+    flags = 0;
+    header->published.store(static_cast<uint32_t>(published), std::memory_order_release);
+}
+
+/*******************************************************************/
+SpectrumSubscriber::SpectrumSubscriber(const std::string &name)
+    : name(name), header(NULL), memory(NULL), size(0), cursor(0), current(0), flags(0), lost(0)
+{
+}
+
+SpectrumSubscriber::~SpectrumSubscriber()
+{
+    close();
+}
+
+bool SpectrumSubscriber::open()
+{
+    if(header) {
+        std::cerr << "Double initialization" << std::endl;
+        return false;
+    }
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if(fd < 0) {
+        std::cerr << "cannot open shared memory " << name << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    struct stat st;
+    void *mapped = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(SpectrumShmHeader))) {
+        size = st.st_size;
+        mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if(mapped == MAP_FAILED) {
+        std::cerr << "cannot map shared memory " << name << std::endl;
+        return false;
+    }
+    memory = static_cast<const uint8_t*>(mapped);
+    header = reinterpret_cast<const SpectrumShmHeader*>(memory);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(memcmp(header->magic, SPECTRUM_SHM_MAGIC, sizeof(header->magic)) != 0
+       || header->slots == 0 || (header->slots & (header->slots - 1)) != 0
+       || header->slotSize < sizeof(SpectrumSlot) + header->bins * sizeof(float)
+       || size < sizeof(SpectrumShmHeader) + static_cast<size_t>(header->slots) * header->slotSize) {
+        std::cerr << name << " is no spectrum ring (or it is still being created)" << std::endl;
+        close();
+        return false;
+    }
+
+    cursor  = header->published.load(std::memory_order_acquire);
+    current = cursor;
+    lost    = 0;
+    return true;
+}
+
+void SpectrumSubscriber::close()
+{
+    if(!header) {
+        return;
+    }
+    munmap(const_cast<uint8_t*>(memory), size);
+    header = NULL;
+    memory = NULL;
+}
+
+bool SpectrumSubscriber::isPublishing() const
+{
+    if(!header || !header->publishing.load(std::memory_order_acquire)) {
+        return false;
+    }
+    /* a publisher that crashed never marks its ring stopped */
+    return kill(static_cast<pid_t>(header->pid), 0) == 0 || errno == EPERM;
+}
+
+const SpectrumSlot *SpectrumSubscriber::slot(uint64_t sequence) const
+{
+    return reinterpret_cast<const SpectrumSlot*>(memory + sizeof(SpectrumShmHeader)
+                                                 + (sequence & (header->slots - 1)) * header->slotSize);
+}
+
+const float *SpectrumSubscriber::next(uint64_t &sequence, uint64_t &timestamp)
+{
+    if(!header) {
+        return NULL;
+    }
+    /* only the low 32 bits are shared, the distance is what counts */
+    const uint32_t newest = header->published.load(std::memory_order_acquire);
+    uint32_t available = newest - static_cast<uint32_t>(cursor);
+    if(available == 0 || available > 0x80000000u) {
+        return NULL;
+    }
+    /* the slot after the newest one may be being overwritten already */
+    if(available >= header->slots) {
+        const uint32_t skipped = available - header->slots + 1;
+        lost      += skipped;
+        cursor    += skipped;
+        available -= skipped;
+    }
+
+    for(; available > 0; --available) {
+        const SpectrumSlot *s = slot(cursor);
+        if(s->lock.load(std::memory_order_acquire) == static_cast<uint32_t>(2 * cursor + 2)) {
+            sequence  = s->sequence;
+            timestamp = s->timestamp;
+            flags     = s->flags;
+            current   = cursor++;
+            return reinterpret_cast<const float*>(s + 1);
+        }
+        /* overwritten since published was read */
+        ++lost;
+        ++cursor;
+    }
+    return NULL;
+}
+
+bool SpectrumSubscriber::isValid() const
+{
+    if(!header) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot(current)->lock.load(std::memory_order_relaxed) == static_cast<uint32_t>(2 * current + 2);
+}
+
+bool SpectrumSubscriber::read(float *spectrum, uint64_t &sequence, uint64_t &timestamp)
+{
+    const float *magnitudes;
+    while((magnitudes = next(sequence, timestamp)) != NULL) {
+        memcpy(spectrum, magnitudes, header->bins * sizeof(float));
+        if(isValid()) {
+            return true;
+        }
+        ++lost;
+    }
+    return false;
+}
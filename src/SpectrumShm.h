@@ -0,0 +1,136 @@
+/*!
+ * \brief Live magnitude spectra for other processes (visualizer, localization, debugging) in a
+ *        POSIX shared memory ring: one publisher on the audio thread, any number of readers.
+ *
+ * Layout of /dev/shm/<name>:
+ *   SpectrumShmHeader
+ *   slots: SpectrumSlot followed by the magnitudes of bins floats, slotSize bytes each
+ *
+ * Single writer, no locks and no system calls on publish: each slot is a seqlock, its lock word
+ * is 2 * sequence + 1 (low 32 bits) while the spectrum is written and 2 * sequence + 2 once it is
+ * complete. Readers use the magnitudes in place and check afterwards that the slot still holds
+ * their sequence; only 32 bit atomics are shared, so readers map the ring read only.
+ *
+ * Only transformed windows are published: while the energy gate is closed (or the capture was
+ * suspended) there are none, the sequence goes on without a hole and the first spectrum after
+ * such a gap has SPECTRUM_SLOT_GAP set. The timestamps tell how long the gap was.
+ */
+
+#ifndef __AK_SPECTRUM_SHM__
+#define __AK_SPECTRUM_SHM__
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#define SPECTRUM_SHM_MAGIC      "AKSHM001"
+#define SPECTRUM_SHM_NAME       "/whistle_spectrum"
+
+/* SpectrumSlot::flags */
+#define SPECTRUM_SLOT_GAP       (1u << 0)   /* windows before this one were not transformed */
+
+struct SpectrumShmHeader
+{
+    char magic[8];
+    uint32_t sampleRate;
+    uint32_t windowSize;        /* samples per window */
+    uint32_t paddedSize;        /* transform size */
+    uint32_t hop;               /* samples between windows */
+    uint32_t bins;              /* magnitudes per spectrum, paddedSize / 2 + 1 */
+    uint32_t slots;             /* spectra kept, a power of two */
+    uint32_t slotSize;          /* bytes per slot */
+    uint32_t pid;               /* of the publisher */
+    uint8_t reserved[24];
+    std::atomic<uint32_t> published;    /* low 32 bits of the spectra published so far */
+    std::atomic<uint32_t> publishing;   /* 0 once the publisher stopped, readers reopen then */
+    uint8_t padding[56];
+};
+
+struct SpectrumSlot
+{
+    std::atomic<uint32_t> lock; /* seqlock word, see above */
+    uint32_t bins;              /* valid magnitudes */
+    uint64_t sequence;          /* 0, 1, 2, ... since the publisher started */
+    uint64_t timestamp;         /* CLOCK_MONOTONIC in ns, capture of the last sample of the buffer completing the window */
+    uint32_t flags;             /* SPECTRUM_SLOT_... */
+    uint8_t padding[4];
+};
+
+/* the audio thread side */
+class SpectrumPublisher
+{
+public:
+    /* slots: rounded up to a power of two */
+    SpectrumPublisher(const std::string &name, unsigned sampleRate, int windowSize, int paddedSize, int hop, int slots);
+    ~SpectrumPublisher();
+
+    /* creates (replaces) and maps the segment */
+    bool open();
+    /* marks the ring stopped and removes its name, readers keep their mapping */
+    void close();
+
+    bool matches(int windowSize, int paddedSize, int hop) const;
+
+    /* audio thread, see STFT::addSpectrumTap: one copy into the ring, never blocks */
+    void publish(const float *spectrum, int length);
+    /* once per buffer before its spectra, no clock is read on publish */
+    void setTimestamp(uint64_t ns) { timestamp = ns; }
+    /* the next spectrum does not follow the last one */
+    void markGap() { flags |= SPECTRUM_SLOT_GAP; }
+
+    uint64_t getPublished() const { return published; }
+
+protected:
+    const std::string name;
+    SpectrumShmHeader layout;
+    uint8_t *memory;
+    size_t size;
+    uint64_t published;
+    uint64_t timestamp;
+    uint32_t flags;             /* of the next spectrum */
+};
+
+/* the reader library, for any process on the robot */
+class SpectrumSubscriber
+{
+public:
+    explicit SpectrumSubscriber(const std::string &name = SPECTRUM_SHM_NAME);
+    ~SpectrumSubscriber();
+
+    /* maps the ring read only, the first spectrum is the next one published */
+    bool open();
+    void close();
+    bool isOpen() const { return header != NULL; }
+    /* false once the publisher stopped (or restarted), close and open again */
+    bool isPublishing() const;
+
+    const SpectrumShmHeader &getHeader() const { return *header; }
+    int getBins() const { return static_cast<int>(header->bins); }
+    float getBinFrequency() const { return static_cast<float>(header->sampleRate) / header->paddedSize; }
+
+    /* the oldest spectrum not read yet, in place in the ring, NULL if there is no new one.
+     * Spectra overwritten before they were read are skipped and counted as lost. */
+    const float *next(uint64_t &sequence, uint64_t &timestamp);
+    /* SPECTRUM_SLOT_... of the last next() */
+    uint32_t getFlags() const { return flags; }
+    /* true if the spectrum of the last next() was not overwritten meanwhile, check after using it */
+    bool isValid() const;
+    /* next() into spectrum (getBins() floats), validated: false if there is no new one */
+    bool read(float *spectrum, uint64_t &sequence, uint64_t &timestamp);
+
+    uint64_t getLost() const { return lost; }
+
+protected:
+    const SpectrumSlot *slot(uint64_t sequence) const;
+
+    const std::string name;
+    const SpectrumShmHeader *header;
+    const uint8_t *memory;
+    size_t size;
+    uint64_t cursor;            /* sequence of the next spectrum to read */
+    uint64_t current;           /* sequence returned by next() */
+    uint32_t flags;
+    uint64_t lost;
+};
+
+#endif
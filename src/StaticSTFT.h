@@ -0,0 +1,143 @@
+/*!
+ * \brief Short Time Fourier Transform with window, hop and transform size fixed at compile time
+ *        and the spectrum handler called directly, for the common window presets.
+ */
+
+#ifndef __AK_STATIC_STFT__
+#define __AK_STATIC_STFT__
+
+#include "Kernels.h"
+#include "Planner.h"
+#include "SlidingWindow.h"
+#include "Timing.h"
+#include <fftw3.h>
+
+/* window presets, samples */
+template<int Time, int Step, int Frequency>
+struct WindowPreset
+{
+    enum {
+        windowTime      = Time,
+        windowTimeStep  = Step,
+        windowFrequency = Frequency,
+        bins            = Frequency / 2 + 1
+    };
+};
+
+typedef WindowPreset<160, 80, 200>      Window160;  /* WhistleConfig.ini, 8 kHz */
+typedef WindowPreset<256, 128, 256>     Window256;
+typedef WindowPreset<512, 256, 512>     Window512;  /* 48 kHz */
+
+/* what a pipeline needs to hold on to a StaticSTFT of any preset and handler */
+class StaticSTFTBase
+{
+public:
+    virtual ~StaticSTFTBase() {}
+    virtual void newData(const int16_t *data, int length, short channels) = 0;
+    /* the next buffer starts a new stream */
+    virtual void restart() = 0;
+};
+
+/* handler: anything callable as handler(const float *spectrum, int length) */
+template<class Preset, class Handler>
+class StaticSTFT : public StaticSTFTBase, protected SlidingWindow
+{
+public:
+    enum {
+        windowFrequency = Preset::windowFrequency,
+        bins            = Preset::bins
+    };
+
+    StaticSTFT(const int channelOffset, const Handler &handler)
+        : SlidingWindow(channelOffset, Preset::windowTime, Preset::windowTimeStep), handler(handler),
+          input(static_cast<float*>(fftwf_malloc(sizeof(float) * windowFrequency))),
+          output(static_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * bins))),
+          plan(NULL)
+    {
+        static_assert(Preset::windowTimeStep > 0 && Preset::windowTimeStep <= Preset::windowTime, "windows must overlap or touch");
+        static_assert(Preset::windowFrequency >= Preset::windowTime, "the transform must hold the whole window");
+
+        plan = refiner.create(windowFrequency, 1, input, output);
+        /* the padding stays zero from now on */
+        for(int i = 0; i < windowFrequency; ++i) {
+            input[i] = 0.0f;
+        }
+    }
+
+    virtual ~StaticSTFT()
+    {
+        if(plan) {
+            destroyPlan(plan);
+        }
+        fftwf_free(input);
+        fftwf_free(output);
+    }
+
+    virtual void newData(const int16_t *data, int length, short channels)
+    {
+        refiner.adopt(plan);
+
+        /* windows start every windowTimeStep samples of the stream: overflown data followed by data */
+        const int total = streamLength(length);
+        int iBegin = 0;
+
+        while(iBegin + Preset::windowTime <= total) {
+            {
+                StageTimer timer(TIMING_CONVERT);
+                fillWindow(input, data, iBegin, channels);
+            }
+            transform();
+            iBegin += Preset::windowTimeStep;
+        }
+
+        keepOverflow(data, length, iBegin, channels);
+    }
+
+    virtual void restart()
+    {
+        SlidingWindow::restart();
+    }
+
+protected:
+    void transform()
+    {
+        {
+            StageTimer timer(TIMING_FFT);
+            fftwf_execute_dft_r2c(plan, input, output);
+        }
+        {
+            StageTimer timer(TIMING_MAGNITUDE);
+            complexMagnitude(reinterpret_cast<const float*>(output), outputMag, bins);
+        }
+
+        StageTimer timer(TIMING_SPECTRUM);
+        handler(static_cast<const float*>(outputMag), static_cast<int>(bins));
+    }
+
+    Handler handler;
+    float outputMag[bins];
+
+    float *input;
+    fftwf_complex *output;
+    /* estimated and measured in the background without wisdom, like STFT */
+    PlanRefiner refiner;
+    fftwf_plan plan;
+};
+
+/* a StaticSTFT if the sizes match a preset, NULL otherwise (use STFT then) */
+template<class Handler>
+StaticSTFTBase *createStaticSTFT(const int channelOffset, const int windowTime, const int windowTimeStep,
+                                 const int windowFrequency, const Handler &handler)
+{
+#define STATIC_STFT_PRESET(P) \
+    if(windowTime == P::windowTime && windowTimeStep == P::windowTimeStep && windowFrequency == P::windowFrequency) { \
+        return new StaticSTFT<P, Handler>(channelOffset, handler); \
+    }
+    STATIC_STFT_PRESET(Window160)
+    STATIC_STFT_PRESET(Window256)
+    STATIC_STFT_PRESET(Window512)
+#undef STATIC_STFT_PRESET
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*!
+ * \brief Whistle detection for many independent recordings at once: the transforms run on a
+ *        worker pool, the detection of all streams is one vectorized pass per frame.
+ */
+
+#include "StreamEngine.h"
+#include "Detector.h"
+#include <algorithm>
+#include <cmath>
+
+/* frames of each stream per task, large enough to amortize the synchronization */
+#define BLOCK_FRAMES        (8192)
+
+StreamEngine::StreamEngine(int windowTime, int windowTimeStep, int windowFrequency,
+                           int binBegin, int binEnd, float threshold, unsigned okayFrames, unsigned missFrames,
+                           int threads)
+    : windowTime(windowTime), windowTimeStep(windowTimeStep), windowFrequency(windowFrequency),
+      binBegin(binBegin), binEnd(binEnd), threshold(threshold), okayFrames(okayFrames), missFrames(missFrames),
+      pool(threads)
+{
+}
+
+StreamEngine::~StreamEngine()
+{
+    for(size_t i = 0; i < streams.size(); ++i) {
+        delete streams[i]->stft;
+        delete streams[i];
+    }
+}
+
+int StreamEngine::addStream(const int16_t *samples, long frames, short channels)
+{
+    Stream *stream = new Stream();
+    stream->samples     = samples;
+    stream->frames      = frames;
+    stream->channels    = channels;
+    stream->nWindows    = 0;
+
+    /* all windows of a block are transformed with one call */
+    const int maxBatch = BLOCK_FRAMES / windowTimeStep + 1;
+    stream->stft = new STFT(0, windowTime, windowTimeStep, windowFrequency, maxBatch,
+                            [this, stream] (const float *spectra, int length, int count) {
+        handleSpectra(*stream, spectra, length, count);
+    });
+    stream->peaks.reserve(maxBatch);
+    stream->means.reserve(maxBatch);
+    stream->deviations.reserve(maxBatch);
+
+    streams.push_back(stream);
+    return static_cast<int>(streams.size()) - 1;
+}
+
+void StreamEngine::handleSpectra(Stream &stream, const float *spectra, int length, int count)
+{
+    for(int i = 0; i < count; ++i) {
+        const float *spectrum = spectra + i * length;
+        float mean, dev;
+        calcMeanDeviation(spectrum, length, mean, dev);
+
+        /* an empty band never stands out, like in Detector */
+        stream.peaks.push_back(binEnd > binBegin ? *std::max_element(spectrum + binBegin, spectrum + binEnd) : -INFINITY);
+        stream.means.push_back(mean);
+        stream.deviations.push_back(dev);
+    }
+}
+
+void StreamEngine::transformBlock(Stream &stream, long begin)
+{
+    stream.peaks.clear();
+    stream.means.clear();
+    stream.deviations.clear();
+
+    if(begin < stream.frames) {
+        const int count = static_cast<int>(std::min<long>(BLOCK_FRAMES, stream.frames - begin));
+        stream.stft->newData(stream.samples + begin * stream.channels, count, stream.channels);
+    }
+    stream.nWindows = static_cast<int>(stream.peaks.size());
+}
+
+void StreamEngine::run()
+{
+    const int nStreams = getStreams();
+    long longest = 0;
+    for(int s = 0; s < nStreams; ++s) {
+        longest = std::max(longest, streams[s]->frames);
+    }
+
+    DetectorBank bank(nStreams, threshold, okayFrames, missFrames);
+    float *peaks        = bank.getPeaks();
+    float *means        = bank.getMeans();
+    float *deviations   = bank.getDeviations();
+    uint32_t *active    = bank.getActive();
+
+    for(long begin = 0; begin < longest; begin += BLOCK_FRAMES) {
+        /* transforms in parallel */
+        pool.parallelFor(nStreams, [this, begin] (int s) {
+            transformBlock(*streams[s], begin);
+        });
+
+        /* detection frame by frame, all streams at once */
+        int nWindows = 0;
+        for(int s = 0; s < nStreams; ++s) {
+            nWindows = std::max(nWindows, streams[s]->nWindows);
+        }
+        for(int w = 0; w < nWindows; ++w) {
+            for(int s = 0; s < nStreams; ++s) {
+                const Stream &stream = *streams[s];
+                active[s] = w < stream.nWindows;
+                if(active[s]) {
+                    peaks[s]        = stream.peaks[w];
+                    means[s]        = stream.means[w];
+                    deviations[s]   = stream.deviations[w];
+                }
+            }
+
+            if(bank.update() > 0) {
+                const uint32_t *detected = bank.getDetected();
+                for(int s = 0; s < nStreams; ++s) {
+                    if(detected[s]) {
+                        streams[s]->detections.push_back((bank.getFrame(s) - 1) * windowTimeStep + windowTime);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,61 @@
+/*!
+ * \brief Whistle detection for many independent recordings at once: the transforms run on a
+ *        worker pool, the detection of all streams is one vectorized pass per frame.
+ */
+
+#ifndef __AK_STREAM_ENGINE__
+#define __AK_STREAM_ENGINE__
+
+#include "DetectorBank.h"
+#include "STFT.h"
+#include "WorkerPool.h"
+#include <cstdint>
+#include <vector>
+
+class StreamEngine
+{
+public:
+    /* window and detection parameters as for STFT and Detector, threads as for WorkerPool */
+    StreamEngine(int windowTime, int windowTimeStep, int windowFrequency,
+                 int binBegin, int binEnd, float threshold, unsigned okayFrames, unsigned missFrames,
+                 int threads = 0);
+    ~StreamEngine();
+
+    /* interleaved samples (first channel is analyzed), they must stay valid until run() returns */
+    int addStream(const int16_t *samples, long frames, short channels);
+
+    /* processes all streams until the longest one ends */
+    void run();
+
+    int getStreams() const { return static_cast<int>(streams.size()); }
+    int getThreads() const { return pool.getThreads(); }
+    /* detections of a stream as frame index of the end of the detecting window */
+    const std::vector<uint64_t> &getDetections(int stream) const { return streams[stream]->detections; }
+
+protected:
+    struct Stream {
+        const int16_t *samples;
+        long frames;
+        short channels;
+        STFT *stft;
+
+        /* per window of the current block: peak of the whistle band and spectrum statistics */
+        std::vector<float> peaks, means, deviations;
+        int nWindows;
+
+        std::vector<uint64_t> detections;
+    };
+
+    void transformBlock(Stream &stream, long begin);
+    void handleSpectra(Stream &stream, const float *spectra, int length, int count);
+
+    const int windowTime, windowTimeStep, windowFrequency;
+    const int binBegin, binEnd;
+    const float threshold;
+    const unsigned okayFrames, missFrames;
+
+    std::vector<Stream*> streams;
+    WorkerPool pool;
+};
+
+#endif
@@ -0,0 +1,223 @@
+/*!
+ * \brief Offline evaluation of detector parameters on labeled recordings: every STFT
+ *        configuration is computed once, all detector parameters are evaluated on its spectra.
+ */
+
+#include "SweepEvaluator.h"
+#include "Detector.h"
+#include "STFT.h"
+#include <algorithm>
+#include <iostream>
+
+/* frames per STFT call while analyzing */
+#define ANALYSIS_FRAMES     (4096)
+
+double SweepResult::precision() const
+{
+    const unsigned detections = truePositives + falsePositives;
+    return detections ? static_cast<double>(truePositives) / detections : 1.0;
+}
+
+double SweepResult::recall() const
+{
+    return whistles ? static_cast<double>(truePositives) / whistles : 1.0;
+}
+
+double SweepResult::f1() const
+{
+    const double p = precision(), r = recall();
+    return (p + r) > 0.0 ? 2.0 * p * r / (p + r) : 0.0;
+}
+
+double SweepResult::meanLatency() const
+{
+    return truePositives ? latencySum / truePositives : 0.0;
+}
+
+SweepEvaluator::SweepEvaluator(int threads)
+    : pool(threads)
+{
+}
+
+SweepEvaluator::~SweepEvaluator()
+{
+    for(size_t i = 0; i < recordings.size(); ++i) {
+        delete recordings[i].file;
+    }
+}
+
+bool SweepEvaluator::addRecording(const std::string &path, const std::vector<std::pair<double, double> > &whistles,
+                                  short rawChannels, int rawSampleRate)
+{
+    Recording recording;
+    recording.file = new FileSource(AudioSource::Handler(), path, ANALYSIS_FRAMES, rawChannels, rawSampleRate);
+    if(!recording.file->openFile()) {
+        delete recording.file;
+        return false;
+    }
+    recording.whistles = whistles;
+    std::sort(recording.whistles.begin(), recording.whistles.end());
+    recordings.push_back(recording);
+    return true;
+}
+
+void SweepEvaluator::analyze(const Recording &recording, int windowSize, int paddedSize, int hop,
+                             const std::vector<std::pair<float, float> > &bands, Analysis &analysis)
+{
+    const FileSource &file = *recording.file;
+    const int rate = file.getSampleRate();
+    const int nBins = paddedSize / 2 + 1;
+
+    /* bins as in the detector, [begin, end) */
+    std::vector<int> binBegins(bands.size()), binEnds(bands.size());
+    for(size_t b = 0; b < bands.size(); ++b) {
+        binBegins[b] = std::min(nBins, static_cast<int>((bands[b].first  * paddedSize) / rate));
+        binEnds[b]   = std::min(nBins, static_cast<int>((bands[b].second * paddedSize) / rate));
+    }
+
+    analysis.means.clear();
+    analysis.deviations.clear();
+    analysis.bandPeaks.assign(bands.size(), std::vector<float>());
+
+    STFT stft(0, windowSize, hop, paddedSize, ANALYSIS_FRAMES / hop + 1,
+              [&] (const float *spectra, int length, int count) {
+        for(int i = 0; i < count; ++i) {
+            const float *spectrum = spectra + i * length;
+            float mean, dev;
+            calcMeanDeviation(spectrum, length, mean, dev);
+            analysis.means.push_back(mean);
+            analysis.deviations.push_back(dev);
+
+            for(size_t b = 0; b < bands.size(); ++b) {
+                const float peak = binEnds[b] > binBegins[b] ?
+                                   *std::max_element(spectrum + binBegins[b], spectrum + binEnds[b]) : 0.0f;
+                analysis.bandPeaks[b].push_back(peak);
+            }
+        }
+    });
+
+    for(long i = 0; i < file.getFrames(); i += ANALYSIS_FRAMES) {
+        const int count = static_cast<int>(std::min<long>(ANALYSIS_FRAMES, file.getFrames() - i));
+        stft.newData(file.getSamples() + i * file.getChannels(), count, file.getChannels());
+    }
+}
+
+void SweepEvaluator::evaluate(const Recording &recording, const Analysis &analysis, int band, float threshold,
+                              int windowSize, int hop, const SweepGrid &grid, SweepResult *results)
+{
+    const std::vector<float> &peaks = analysis.bandPeaks[band];
+    const size_t nWindows = peaks.size();
+    const double rate = recording.file->getSampleRate();
+
+    std::vector<bool> found(nWindows);
+    for(size_t w = 0; w < nWindows; ++w) {
+        found[w] = peaks[w] > analysis.means[w] + threshold * analysis.deviations[w];
+    }
+
+    std::vector<bool> matched(recording.whistles.size());
+    for(size_t o = 0; o < grid.okayFrames.size(); ++o) {
+        for(size_t m = 0; m < grid.missFrames.size(); ++m) {
+            SweepResult &result = results[o * grid.missFrames.size() + m];
+            result.whistles += static_cast<unsigned>(recording.whistles.size());
+
+            Detector detector(0, 1, threshold, grid.okayFrames[o], grid.missFrames[m]);
+            std::fill(matched.begin(), matched.end(), false);
+
+            for(size_t w = 0; w < nWindows; ++w) {
+                if(!detector.update(found[w])) {
+                    continue;
+                }
+
+                /* the detection is known when the window is complete */
+                const double t = (w * hop + windowSize) / rate;
+                bool truePositive = false;
+                for(size_t k = 0; k < recording.whistles.size(); ++k) {
+                    const std::pair<double, double> &whistle = recording.whistles[k];
+                    if(!matched[k] && t >= whistle.first && t <= whistle.second + grid.tolerance) {
+                        matched[k] = true;
+                        truePositive = true;
+                        result.latencySum += t - whistle.first;
+                        result.latencyMax = std::max(result.latencyMax, t - whistle.first);
+                        break;
+                    }
+                }
+                if(truePositive) {
+                    ++result.truePositives;
+                } else {
+                    ++result.falsePositives;
+                }
+            }
+        }
+    }
+}
+
+std::vector<SweepResult> SweepEvaluator::run(const SweepGrid &grid)
+{
+    std::vector<SweepResult> results;
+
+    std::vector<std::pair<float, float> > bands;
+    for(size_t b = 0; b < grid.whistleBegins.size(); ++b) {
+        for(size_t e = 0; e < grid.whistleEnds.size(); ++e) {
+            if(grid.whistleBegins[b] < grid.whistleEnds[e]) {
+                bands.push_back(std::make_pair(grid.whistleBegins[b], grid.whistleEnds[e]));
+            }
+        }
+    }
+    const size_t nCounters = grid.okayFrames.size() * grid.missFrames.size();
+    const size_t nTasks = bands.size() * grid.thresholds.size();
+    if(recordings.empty() || nTasks == 0 || nCounters == 0) {
+        return results;
+    }
+
+    std::vector<Analysis> analyses(recordings.size());
+    for(size_t ws = 0; ws < grid.windowSizes.size(); ++ws) {
+        for(size_t ps = 0; ps < grid.paddedSizes.size(); ++ps) {
+            for(size_t hs = 0; hs < grid.hops.size(); ++hs) {
+                const int windowSize = grid.windowSizes[ws];
+                const int paddedSize = grid.paddedSizes[ps];
+                const int hop        = grid.hops[hs];
+                if(windowSize <= 0 || hop <= 0 || paddedSize < windowSize) {
+                    continue;
+                }
+                std::cout << "Analyzing window " << windowSize << ", padded " << paddedSize << ", hop " << hop
+                          << " (" << nTasks * nCounters << " detector configurations) ..." << std::endl;
+
+                /* one transform per recording and STFT configuration */
+                pool.parallelFor(static_cast<int>(recordings.size()), [&] (int r) {
+                    analyze(recordings[r], windowSize, paddedSize, hop, bands, analyses[r]);
+                });
+
+                /* every band and threshold is a task with its own block of results */
+                const size_t first = results.size();
+                results.resize(first + nTasks * nCounters);
+                for(size_t i = 0; i < nTasks * nCounters; ++i) {
+                    const size_t task = i / nCounters, counter = i % nCounters;
+                    SweepResult &result = results[first + i];
+                    result.windowSize       = windowSize;
+                    result.paddedSize       = paddedSize;
+                    result.hop              = hop;
+                    result.whistleBegin     = bands[task / grid.thresholds.size()].first;
+                    result.whistleEnd       = bands[task / grid.thresholds.size()].second;
+                    result.threshold        = grid.thresholds[task % grid.thresholds.size()];
+                    result.okayFrames       = grid.okayFrames[counter / grid.missFrames.size()];
+                    result.missFrames       = grid.missFrames[counter % grid.missFrames.size()];
+                    result.whistles         = 0;
+                    result.truePositives    = 0;
+                    result.falsePositives   = 0;
+                    result.latencySum       = 0.0;
+                    result.latencyMax       = 0.0;
+                }
+
+                pool.parallelFor(static_cast<int>(nTasks), [&] (int task) {
+                    const int band = task / static_cast<int>(grid.thresholds.size());
+                    const float threshold = grid.thresholds[task % grid.thresholds.size()];
+                    for(size_t r = 0; r < recordings.size(); ++r) {
+                        evaluate(recordings[r], analyses[r], band, threshold, windowSize, hop, grid,
+                                 &results[first + task * nCounters]);
+                    }
+                });
+            }
+        }
+    }
+    return results;
+}
@@ -0,0 +1,79 @@
+/*!
+ * \brief Offline evaluation of detector parameters on labeled recordings: every STFT
+ *        configuration is computed once, all detector parameters are evaluated on its spectra.
+ */
+
+#ifndef __AK_SWEEP_EVALUATOR__
+#define __AK_SWEEP_EVALUATOR__
+
+#include "FileSource.h"
+#include "WorkerPool.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+/* all combinations of these values are evaluated */
+struct SweepGrid
+{
+    std::vector<int> windowSizes, paddedSizes, hops;
+    std::vector<float> whistleBegins, whistleEnds;      /* Hz */
+    std::vector<float> thresholds;
+    std::vector<unsigned> okayFrames, missFrames;
+    double tolerance;       /* detections up to this long after the whistle end still count, s */
+};
+
+struct SweepResult
+{
+    int windowSize, paddedSize, hop;
+    float whistleBegin, whistleEnd, threshold;
+    unsigned okayFrames, missFrames;
+
+    unsigned whistles;          /* labeled */
+    unsigned truePositives;     /* labeled whistles with a detection */
+    unsigned falsePositives;    /* detections outside of whistles and repeated detections */
+    double latencySum, latencyMax;   /* from the labeled begin to the detection, s */
+
+    double precision() const;
+    double recall() const;
+    double f1() const;
+    double meanLatency() const;
+};
+
+class SweepEvaluator
+{
+public:
+    /* threads as for WorkerPool */
+    explicit SweepEvaluator(int threads = 0);
+    ~SweepEvaluator();
+
+    /* whistles: labeled begin and end in s; raw files are described by rawChannels and rawSampleRate */
+    bool addRecording(const std::string &path, const std::vector<std::pair<double, double> > &whistles,
+                      short rawChannels, int rawSampleRate);
+
+    /* results of all valid combinations (whistle begin below end) */
+    std::vector<SweepResult> run(const SweepGrid &grid);
+
+    int getRecordings() const { return static_cast<int>(recordings.size()); }
+
+protected:
+    struct Recording {
+        FileSource *file;
+        std::vector<std::pair<double, double> > whistles;
+    };
+
+    /* spectrum statistics and band peaks of all windows of a recording for one STFT configuration */
+    struct Analysis {
+        std::vector<float> means, deviations;
+        std::vector<std::vector<float> > bandPeaks;     /* per band, per window */
+    };
+
+    void analyze(const Recording &recording, int windowSize, int paddedSize, int hop,
+                 const std::vector<std::pair<float, float> > &bands, Analysis &analysis);
+    void evaluate(const Recording &recording, const Analysis &analysis, int band, float threshold,
+                  int windowSize, int hop, const SweepGrid &grid, SweepResult *results);
+
+    WorkerPool pool;
+    std::vector<Recording> recordings;
+};
+
+#endif
@@ -0,0 +1,223 @@
+/*!
+ * \brief Low overhead timing probes for the audio pipeline: per stage histograms, the most
+ *        recent durations and the latency from whistle onset to detection.
+ */
+
+#include "Timing.h"
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+/* log-linear buckets: values below 16 ns exactly, above 8 sub-buckets per power of two */
+#define SUB_BUCKET_BITS     (3)
+#define SUB_BUCKETS         (1 << SUB_BUCKET_BITS)
+#define MAX_EXPONENT        (40)    /* ~18 minutes */
+#define N_BUCKETS           (2 * SUB_BUCKETS + (MAX_EXPONENT - SUB_BUCKET_BITS) * SUB_BUCKETS)
+#define N_RECENT            (64)
+
+static const char *stageNames[TIMING_STAGES] = {
+    "read", "buffer", "convert", "fft", "magnitude", "spectrum", "action", "latency", "resume"
+};
+
+class Histogram
+{
+public:
+    void add(uint64_t ns)
+    {
+        counts[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(ns, std::memory_order_relaxed);
+
+        uint64_t m = max.load(std::memory_order_relaxed);
+        while(ns > m && !max.compare_exchange_weak(m, ns, std::memory_order_relaxed)) {
+        }
+
+        const unsigned i = recentIndex.fetch_add(1, std::memory_order_relaxed);
+        recent[i % N_RECENT].store(ns, std::memory_order_relaxed);
+    }
+
+    /* upper bound of the bucket holding the p-th fraction of all values, at most the maximum */
+    uint64_t percentile(double p) const
+    {
+        const uint64_t n = total.load(std::memory_order_relaxed);
+        if(n == 0) {
+            return 0;
+        }
+        const uint64_t rank = static_cast<uint64_t>(p * (n - 1)) + 1;
+        uint64_t seen = 0;
+        for(int i = 0; i < N_BUCKETS; ++i) {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if(seen >= rank) {
+                return std::min(upperBound(i), max.load(std::memory_order_relaxed));
+            }
+        }
+        return max.load(std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t maximum() const { return max.load(std::memory_order_relaxed); }
+    double mean() const
+    {
+        const uint64_t n = count();
+        return n ? static_cast<double>(sum.load(std::memory_order_relaxed)) / n : 0.0;
+    }
+    uint64_t last() const
+    {
+        const unsigned i = recentIndex.load(std::memory_order_relaxed);
+        return i ? recent[(i - 1) % N_RECENT].load(std::memory_order_relaxed) : 0;
+    }
+
+    void reset()
+    {
+        for(int i = 0; i < N_BUCKETS; ++i) {
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+        total.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static int bucket(uint64_t ns)
+    {
+        if(ns < 2 * SUB_BUCKETS) {
+            return static_cast<int>(ns);
+        }
+        int exponent = 63 - __builtin_clzll(ns);
+        if(exponent > MAX_EXPONENT) {
+            return N_BUCKETS - 1;
+        }
+        const int sub = static_cast<int>(ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return 2 * SUB_BUCKETS + (exponent - SUB_BUCKET_BITS - 1) * SUB_BUCKETS + sub;
+    }
+
+    static uint64_t upperBound(int index)
+    {
+        if(index < 2 * SUB_BUCKETS) {
+            return index;
+        }
+        const int exponent = (index - 2 * SUB_BUCKETS) / SUB_BUCKETS + SUB_BUCKET_BITS + 1;
+        const int sub = (index - 2 * SUB_BUCKETS) % SUB_BUCKETS;
+        return ((static_cast<uint64_t>(SUB_BUCKETS + sub + 1)) << (exponent - SUB_BUCKET_BITS)) - 1;
+    }
+
+    std::atomic<uint32_t> counts[N_BUCKETS];
+    std::atomic<uint64_t> total, sum, max;
+    std::atomic<uint64_t> recent[N_RECENT];
+    std::atomic<unsigned> recentIndex;
+};
+
+static Histogram histograms[TIMING_STAGES];
+static std::atomic<bool> enabled(false);
+static std::atomic<bool> anchoring(false);
+
+/* capture anchor, written by the capture thread, read by the processing thread (seqlock) */
+static std::atomic<unsigned> anchorSequence(0);
+static std::atomic<uint64_t> anchorFrame(0), anchorTime(0);
+static std::atomic<unsigned> anchorSampleRate(0);
+
+uint64_t Timing::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+void Timing::setEnabled(bool enable)
+{
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool Timing::isEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void Timing::setAnchoring(bool anchor)
+{
+    anchoring.store(anchor, std::memory_order_relaxed);
+}
+
+bool Timing::isAnchoring()
+{
+    return enabled.load(std::memory_order_relaxed) || anchoring.load(std::memory_order_relaxed);
+}
+
+void Timing::record(TimingStage stage, uint64_t ns)
+{
+    histograms[stage].add(ns);
+}
+
+void Timing::setCaptureAnchor(uint64_t frame, uint64_t timeNs, unsigned sampleRate)
+{
+    const unsigned sequence = anchorSequence.load(std::memory_order_relaxed);
+    anchorSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    anchorFrame.store(frame, std::memory_order_relaxed);
+    anchorTime.store(timeNs, std::memory_order_relaxed);
+    anchorSampleRate.store(sampleRate, std::memory_order_relaxed);
+    anchorSequence.store(sequence + 2, std::memory_order_release);
+}
+
+uint64_t Timing::captureTime(uint64_t frame)
+{
+    uint64_t f, t;
+    unsigned rate, sequence;
+    do {
+        sequence = anchorSequence.load(std::memory_order_acquire);
+        f    = anchorFrame.load(std::memory_order_relaxed);
+        t    = anchorTime.load(std::memory_order_relaxed);
+        rate = anchorSampleRate.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while((sequence & 1) || sequence != anchorSequence.load(std::memory_order_relaxed));
+
+    if(rate == 0) {
+        return 0;
+    }
+    /* frames before and after the anchor */
+    if(frame <= f) {
+        return t - (f - frame) * 1000000000ull / rate;
+    }
+    return t + (frame - f) * 1000000000ull / rate;
+}
+
+void Timing::recordLatency(uint64_t onsetFrame)
+{
+    if(!isEnabled()) {
+        return;
+    }
+    const uint64_t onset = captureTime(onsetFrame);
+    const uint64_t t = now();
+    if(onset && onset <= t) {
+        record(TIMING_LATENCY, t - onset);
+    }
+}
+
+std::string Timing::report()
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << std::setw(10) << "stage" << std::setw(10) << "count"
+        << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p90"
+        << std::setw(10) << "p99" << std::setw(10) << "max" << std::setw(10) << "last" << "  [us]" << std::endl;
+    for(int i = 0; i < TIMING_STAGES; ++i) {
+        const Histogram &h = histograms[i];
+        out << std::setw(10) << stageNames[i] << std::setw(10) << h.count()
+            << std::setw(10) << h.mean() / 1000.0
+            << std::setw(10) << h.percentile(0.50) / 1000.0
+            << std::setw(10) << h.percentile(0.90) / 1000.0
+            << std::setw(10) << h.percentile(0.99) / 1000.0
+            << std::setw(10) << h.maximum() / 1000.0
+            << std::setw(10) << h.last() / 1000.0 << std::endl;
+    }
+    return out.str();
+}
+
+void Timing::reset()
+{
+    for(int i = 0; i < TIMING_STAGES; ++i) {
+        histograms[i].reset();
+    }
+}
@@ -0,0 +1,71 @@
+/*!
+ * \brief Low overhead timing probes for the audio pipeline: per stage histograms, the most
+ *        recent durations and the latency from whistle onset to detection.
+ */
+
+#ifndef __AK_TIMING__
+#define __AK_TIMING__
+
+#include <cstdint>
+#include <string>
+
+enum TimingStage {
+    TIMING_READ,            /* waiting for and reading a period from ALSA */
+    TIMING_BUFFER,          /* whole handler for one captured buffer */
+    TIMING_CONVERT,         /* int16 to float conversion of a window */
+    TIMING_FFT,             /* fftwf_execute */
+    TIMING_MAGNITUDE,       /* magnitude of the complex spectrum */
+    TIMING_SPECTRUM,        /* spectrum handler (detection) */
+    TIMING_ACTION,          /* whistleAction */
+    TIMING_LATENCY,         /* capture of the onset window to whistleAction */
+    TIMING_RESUME,          /* unpause to the first captured buffer */
+    TIMING_STAGES
+};
+
+class Timing
+{
+public:
+    /* CLOCK_MONOTONIC in ns */
+    static uint64_t now();
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    static void record(TimingStage stage, uint64_t ns);
+
+    /* the capture sources keep the anchor while timing is enabled or anchoring was requested */
+    static void setAnchoring(bool anchoring);
+    static bool isAnchoring();
+    /* the capture source maps its frame counter to the (monotonic) capture time */
+    static void setCaptureAnchor(uint64_t frame, uint64_t timeNs, unsigned sampleRate);
+    static uint64_t captureTime(uint64_t frame);
+    /* records the latency from the capture of the given frame until now */
+    static void recordLatency(uint64_t onsetFrame);
+
+    /* count, mean and percentiles per stage in us */
+    static std::string report();
+    static void reset();
+};
+
+/* times its own scope */
+class StageTimer
+{
+public:
+    explicit StageTimer(TimingStage stage)
+        : stage(stage), begin(Timing::isEnabled() ? Timing::now() : 0)
+    {
+    }
+
+    ~StageTimer()
+    {
+        if(begin) {
+            Timing::record(stage, Timing::now() - begin);
+        }
+    }
+
+private:
+    const TimingStage stage;
+    const uint64_t begin;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*!
+ * \brief Fixed pool of worker threads with per worker task queues and work stealing.
+ */
+
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threads)
+    : queues(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency())),
+      task(NULL), remaining(0), generation(0), stopping(false)
+{
+    for(size_t i = 1; i < queues.size(); ++i) {
+        workers.push_back(std::thread(&WorkerPool::workerMain, this, static_cast<int>(i)));
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+}
+
+void WorkerPool::parallelFor(int n, const std::function<void (int)> &function)
+{
+    if(n <= 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        /* written before the items are queued, the queue locks order it for the workers */
+        task = &function;
+        remaining = n;
+        for(int i = 0; i < n; ++i) {
+            Queue &queue = queues[i % queues.size()];
+            std::lock_guard<std::mutex> queueLock(queue.mutex);
+            queue.items.push_back(i);
+        }
+        ++generation;
+    }
+    wake.notify_all();
+
+    while(runOne(0)) {
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while(remaining.load() > 0) {
+        finished.wait(lock);
+    }
+    task = NULL;
+}
+
+bool WorkerPool::runOne(int self)
+{
+    const int nQueues = static_cast<int>(queues.size());
+    int item = -1;
+
+    /* own queue from the back, the others from the front */
+    for(int k = 0; k < nQueues && item < 0; ++k) {
+        Queue &queue = queues[(self + k) % nQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.items.empty()) {
+            if(k == 0) {
+                item = queue.items.back();
+                queue.items.pop_back();
+            } else {
+                item = queue.items.front();
+                queue.items.pop_front();
+            }
+        }
+    }
+    if(item < 0) {
+        return false;
+    }
+
+    (*task)(item);
+
+    if(--remaining == 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.notify_all();
+    }
+    return true;
+}
+
+void WorkerPool::workerMain(int self)
+{
+    unsigned long seen = 0;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(!stopping && generation == seen) {
+                wake.wait(lock);
+            }
+            if(stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        while(runOne(self)) {
+        }
+    }
+}
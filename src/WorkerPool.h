@@ -0,0 +1,51 @@
+/*!
+ * \brief Fixed pool of worker threads with per worker task queues and work stealing.
+ */
+
+#ifndef __AK_WORKER_POOL__
+#define __AK_WORKER_POOL__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+    /* threads: number of threads working on a parallelFor including the caller, 0: one per cpu */
+    explicit WorkerPool(int threads = 0);
+    ~WorkerPool();
+
+    /* calls task(i) for all 0 <= i < n and returns when all calls are done; the indices are
+     * dealt out round robin, idle threads steal from the others */
+    void parallelFor(int n, const std::function<void (int)> &task);
+
+    int getThreads() const { return static_cast<int>(queues.size()); }
+
+protected:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<int> items;
+        char padding[64];
+    };
+
+    void workerMain(int self);
+    /* runs one item of the own queue or stolen from another, false if there is none */
+    bool runOne(int self);
+
+    std::vector<Queue> queues;      /* queue 0 belongs to the caller of parallelFor */
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    const std::function<void (int)> *task;
+    std::atomic<int> remaining;
+    unsigned long generation;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,33 @@
+// whistle detection in many recordings at once, e.g. all robots of a match
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern int main_streams(const std::string& configFile, const std::vector<std::string>& inputFiles, int threads);
+
+/* usage: whistle_detector_batch [-c WhistleConfig.ini] [-j threads] recording... */
+int main(int argc, char **argv)
+{
+    std::string configFile = "WhistleConfig.ini";
+    int threads = 0;
+    std::vector<std::string> inputFiles;
+
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            configFile = argv[++i];
+        } else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else {
+            inputFiles.push_back(argv[i]);
+        }
+    }
+    if(inputFiles.empty()) {
+        std::cerr << "usage: " << argv[0] << " [-c WhistleConfig.ini] [-j threads] recording..." << std::endl;
+        return 1;
+    }
+
+    return main_streams(configFile, inputFiles, threads) == 0 ? 0 : 1;
+}
@@ -0,0 +1,256 @@
+// benchmarks of the processing stages on synthetic signals, no sound hardware needed
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Detector.h"
+#include "EnergyGate.h"
+#include "FixedSTFT.h"
+#include "Goertzel.h"
+#include "Kernels.h"
+#include "MultiChannelSTFT.h"
+#include "SignalGenerator.h"
+#include "STFT.h"
+#include "StaticSTFT.h"
+#include "Timing.h"
+
+#define SAMPLE_RATE         (8000)
+#define CHANNELS            (2)
+#define PERIOD_SIZE         (256)
+#define WHISTLE_BEGIN       (2000.0f)
+#define WHISTLE_END         (2200.0f)
+#define REPETITIONS         (5)
+
+struct WindowCase {
+    int windowSize, windowSizePadded, hop;
+};
+
+static const WindowCase windowCases[] = {
+    { 160,  200,  80},      /* WhistleConfig.ini */
+    { 160,  200,  40},
+    { 256,  256, 128},
+    { 256,  512,  64},
+    { 512,  512, 256},
+    {1024, 1024, 512},
+};
+
+static std::vector<int16_t> samples;
+static long nFrames;
+
+/* crowd noise with two whistles, the second one partly clipped */
+static void generateSignal(float seconds)
+{
+    SignalGenerator generator(SAMPLE_RATE, CHANNELS, static_cast<long>(seconds * SAMPLE_RATE));
+    generator.setChannel(1, 0.8f, 3);
+    generator.addCrowd(0.1f);
+    generator.addTone(2050.0f, 2150.0f, 0.2f, 0.2f * seconds, 1.5f);
+    generator.addTone(2150.0f, 2080.0f, 0.6f, 0.6f * seconds, 1.5f);
+    generator.addNoise(0.01f);
+    generator.clip(0.5f);
+
+    samples = generator.render();
+    nFrames = generator.getFrames();
+}
+
+/* best of some runs over the whole signal in buffers of PERIOD_SIZE frames, in ns */
+template<typename Process>
+static uint64_t measure(Process process)
+{
+    uint64_t best = ~0ull;
+    for(int r = 0; r < REPETITIONS; ++r) {
+        const uint64_t begin = Timing::now();
+        for(long i = 0; i < nFrames; i += PERIOD_SIZE) {
+            const int count = static_cast<int>(std::min<long>(PERIOD_SIZE, nFrames - i));
+            process(&samples[i * CHANNELS], count);
+        }
+        best = std::min(best, Timing::now() - begin);
+    }
+    return best;
+}
+
+static void report(const WindowCase &c, const std::string &name, uint64_t ns, long frames, int whistles = -1)
+{
+    std::ostringstream window;
+    window << c.windowSize << "/" << c.windowSizePadded << "/" << c.hop;
+    std::cout << std::setw(14) << window.str() << std::setw(21) << name
+              << std::setw(12) << std::setprecision(1) << static_cast<double>(ns) / frames
+              << std::setw(14) << std::setprecision(0) << frames * 1e9 / ns
+              << std::setw(12) << std::setprecision(1) << frames * 1e9 / ns / SAMPLE_RATE;
+    if(whistles >= 0) {
+        std::cout << std::setw(10) << whistles;
+    }
+    std::cout << std::endl;
+}
+
+static void benchmark(const WindowCase &c)
+{
+    const int binBegin = static_cast<int>(WHISTLE_BEGIN * c.windowSizePadded / SAMPLE_RATE);
+    const int binEnd   = static_cast<int>(WHISTLE_END   * c.windowSizePadded / SAMPLE_RATE);
+    const int maxBatch = PERIOD_SIZE / c.hop + 1;
+
+    /* transforms only */
+    {
+        STFT stft(0, c.windowSize, c.hop, c.windowSizePadded, [] (const float*, int) {});
+        report(c, "stft", measure([&] (const int16_t *data, int count) { stft.newData(data, count, CHANNELS); }), nFrames);
+    }
+    {
+        STFT stft(0, c.windowSize, c.hop, c.windowSizePadded, maxBatch, [] (const float*, int, int) {});
+        report(c, "stft batched", measure([&] (const int16_t *data, int count) { stft.newData(data, count, CHANNELS); }), nFrames);
+    }
+    static const FusionMode fusions[] = {FUSION_MAX, FUSION_POWER, FUSION_DELAY_SUM};
+    for(size_t k = 0; k < sizeof(fusions) / sizeof(fusions[0]); ++k) {
+        /* all channels per transform call */
+        MultiChannelSTFT stft(CHANNELS, c.windowSize, c.hop, c.windowSizePadded, fusions[k], std::vector<float>(), [] (const float*, int) {});
+        report(c, std::string("stft fused ") + fusionName(fusions[k]),
+               measure([&] (const int16_t *data, int count) { stft.newData(data, count, CHANNELS); }), nFrames);
+    }
+    {
+        Goertzel goertzel(0, c.windowSize, c.hop, c.windowSizePadded, binBegin, binEnd, [] (const float*, int, float, float) {});
+        report(c, "goertzel", measure([&] (const int16_t *data, int count) { goertzel.newData(data, count, CHANNELS); }), nFrames);
+    }
+    if(FixedFFT::isSupported(c.windowSizePadded)) {
+        FixedSTFT stft(0, c.windowSize, c.hop, c.windowSizePadded, [] (const uint32_t*, int) {});
+        report(c, "stft fixed", measure([&] (const int16_t *data, int count) { stft.newData(data, count, CHANNELS); }), nFrames);
+    }
+
+    /* detection only, on the spectra of the whole signal, for every noise floor */
+    std::vector<float> spectra;
+    int length = 0;
+    {
+        STFT stft(0, c.windowSize, c.hop, c.windowSizePadded, [&] (const float *spectrum, int n) {
+            spectra.insert(spectra.end(), spectrum, spectrum + n);
+            length = n;
+        });
+        for(long i = 0; i < nFrames; i += PERIOD_SIZE) {
+            stft.newData(&samples[i * CHANNELS], static_cast<int>(std::min<long>(PERIOD_SIZE, nFrames - i)), CHANNELS);
+        }
+    }
+    static const NoiseFloorMode noiseFloors[] = {NOISE_FLOOR_FRAME, NOISE_FLOOR_EMA, NOISE_FLOOR_PERCENTILE};
+    for(size_t k = 0; k < sizeof(noiseFloors) / sizeof(noiseFloors[0]); ++k) {
+        const size_t nSpectra = length ? spectra.size() / length : 0;
+        Detector detector(binBegin, binEnd, 2.5f, 30 * 80 / c.hop, 7 * 80 / c.hop);
+        uint64_t best = ~0ull;
+        int whistles = 0;
+        for(int r = 0; r < REPETITIONS; ++r) {
+            /* one second of noise floor */
+            detector.reset();
+            detector.setNoiseFloor(noiseFloors[k], SAMPLE_RATE / c.hop);
+            whistles = 0;
+            const uint64_t begin = Timing::now();
+            for(size_t i = 0; i < nSpectra; ++i) {
+                whistles += detector.handleSpectrum(&spectra[i * length], length);
+            }
+            best = std::min(best, Timing::now() - begin);
+        }
+        report(c, std::string("detector ") + noiseFloorName(noiseFloors[k]), best, nFrames, whistles);
+    }
+
+    /* whole pipeline as in executeAction, the detection frames scale with the hop */
+    {
+        Detector detector(binBegin, binEnd, 2.5f, 30 * 80 / c.hop, 7 * 80 / c.hop);
+        int whistles = 0;
+        STFT stft(0, c.windowSize, c.hop, c.windowSizePadded, [&] (const float *spectrum, int n) {
+            whistles += detector.handleSpectrum(spectrum, n);
+        });
+        const uint64_t ns = measure([&] (const int16_t *data, int count) { stft.newData(data, count, CHANNELS); });
+        report(c, "pipeline fft", ns, nFrames, whistles / REPETITIONS);
+    }
+    {
+        /* transforms only while the gate is open, restarted with the pre-roll as in Pipeline::process */
+        Detector detector(binBegin, binEnd, 2.5f, 30 * 80 / c.hop, 7 * 80 / c.hop);
+        int whistles = 0;
+        STFT stft(0, c.windowSize, c.hop, c.windowSizePadded, [&] (const float *spectrum, int n) {
+            whistles += detector.handleSpectrum(spectrum, n);
+        });
+        const int preRoll = std::max(c.windowSize, SAMPLE_RATE / 10);
+        const int hold = std::max((7 * 80 / c.hop + 2) * c.hop + c.windowSize, SAMPLE_RATE / 2);
+        EnergyGate gate(SAMPLE_RATE, WHISTLE_BEGIN, WHISTLE_END, 6.0f, hold, 2 * SAMPLE_RATE);
+        long transformed = 0;
+        const uint64_t ns = measure([&] (const int16_t *data, int count) {
+            const long i = (data - &samples[0]) / CHANNELS;
+            if(i == 0) {
+                gate.reset();
+                transformed = 0;
+            }
+            const bool wasOpen = gate.isOpen();
+            if(!gate.update(data, count, CHANNELS)) {
+                return;
+            }
+            if(!wasOpen) {
+                stft.restart();
+                const long begin = std::max(0L, i - preRoll);
+                stft.newData(&samples[begin * CHANNELS], static_cast<int>(i - begin), CHANNELS);
+            }
+            stft.newData(data, count, CHANNELS);
+            transformed += count;
+        });
+        std::ostringstream name;
+        name << "pipeline gated " << 100 * transformed / nFrames << "%";
+        report(c, name.str(), ns, nFrames, whistles / REPETITIONS);
+    }
+    {
+        /* only for the window presets */
+        Detector detector(binBegin, binEnd, 2.5f, 30 * 80 / c.hop, 7 * 80 / c.hop);
+        int whistles = 0;
+        auto handleSpectrum = [&] (const float *spectrum, int n) {
+            whistles += detector.handleSpectrum(spectrum, n);
+        };
+        StaticSTFTBase *stft = createStaticSTFT(0, c.windowSize, c.hop, c.windowSizePadded, handleSpectrum);
+        if(stft) {
+            const uint64_t ns = measure([&] (const int16_t *data, int count) { stft->newData(data, count, CHANNELS); });
+            report(c, "pipeline static", ns, nFrames, whistles / REPETITIONS);
+            delete stft;
+        }
+    }
+    {
+        Detector detector(binBegin, binEnd, 2.5f, 30 * 80 / c.hop, 7 * 80 / c.hop);
+        int whistles = 0;
+        Goertzel goertzel(0, c.windowSize, c.hop, c.windowSizePadded, binBegin, binEnd,
+                          [&] (const float *band, int, float mean, float dev) {
+            whistles += detector.handleBand(band, mean, dev);
+        });
+        const uint64_t ns = measure([&] (const int16_t *data, int count) { goertzel.newData(data, count, CHANNELS); });
+        report(c, "pipeline goertzel", ns, nFrames, whistles / REPETITIONS);
+    }
+    if(FixedFFT::isSupported(c.windowSizePadded)) {
+        Detector detector(binBegin, binEnd, 2.5f, 30 * 80 / c.hop, 7 * 80 / c.hop);
+        int whistles = 0;
+        FixedSTFT stft(0, c.windowSize, c.hop, c.windowSizePadded, [&] (const uint32_t *spectrum, int n) {
+            whistles += detector.handleFixedSpectrum(spectrum, n);
+        });
+        const uint64_t ns = measure([&] (const int16_t *data, int count) { stft.newData(data, count, CHANNELS); });
+        report(c, "pipeline fixed", ns, nFrames, whistles / REPETITIONS);
+    }
+}
+
+/* usage: whistle_detector_bench [seconds [kernels]] */
+int main(int argc, char **argv)
+{
+    const float seconds = (argc > 1) ? std::stof(argv[1]) : 20.0f;
+    const std::string kernels = (argc > 2) ? argv[2] : "auto";
+    if(seconds <= 0.0f) {
+        std::cerr << "Signal length must be positive!" << std::endl;
+        return 1;
+    }
+    if(!selectKernels(kernels)) {
+        std::cerr << "Kernels " << kernels << " are not supported!" << std::endl;
+        return 1;
+    }
+
+    generateSignal(seconds);
+    std::cout << seconds << " s of synthetic signal, " << SAMPLE_RATE << " Hz, " << CHANNELS << " channels, "
+              << PERIOD_SIZE << " frames per buffer, " << kernelName() << " kernels, best of "
+              << REPETITIONS << " runs." << std::endl;
+    std::cout << std::fixed
+              << std::setw(14) << "window" << std::setw(21) << "stage" << std::setw(12) << "ns/frame"
+              << std::setw(14) << "frames/s" << std::setw(12) << "x realtime" << std::setw(10) << "whistles" << std::endl;
+
+    for(size_t i = 0; i < sizeof(windowCases) / sizeof(windowCases[0]); ++i) {
+        benchmark(windowCases[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+// runs a recording through the float and the fixed point STFT and compares the detector decisions
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+
+#include "Detector.h"
+#include "FileSource.h"
+#include "FixedSTFT.h"
+#include "Kernels.h"
+#include "STFT.h"
+#include "SoundConfig.h"
+
+/* the decision of every frame and the onsets of the detections of one engine */
+struct Decisions {
+    std::vector<bool> frames;
+    std::vector<uint64_t> onsets;
+};
+
+/* onsets of a that are not in b, the first few */
+static void printMissing(const char *name, const std::vector<uint64_t> &a, const std::vector<uint64_t> &b)
+{
+    std::vector<uint64_t> missing;
+    std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(missing));
+    for(size_t i = 0; i < missing.size() && i < 10; ++i) {
+        std::cout << "Whistle at frame " << missing[i] << " only " << name << std::endl;
+    }
+}
+
+/* usage: whistle_detector_compare recording [WhistleConfig.ini], exits with 0 if the detections are the same */
+int main(int argc, char **argv)
+{
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " recording [WhistleConfig.ini]" << std::endl;
+        return 1;
+    }
+    const std::string configFile = (argc > 2) ? argv[2] : "WhistleConfig.ini";
+
+    boost::property_tree::ptree iniConfig;
+    boost::property_tree::ini_parser::read_ini(configFile, iniConfig);
+
+    const int sampleRate        = iniConfig.get<int>("Frequencies.SampleRate");
+    const float whistleBegin    = iniConfig.get<float>("Frequencies.WhistleBegin");
+    const float whistleEnd      = iniConfig.get<float>("Frequencies.WhistleEnd");
+    const int windowSize        = iniConfig.get<int>("Time.WindowSize");
+    const int windowSizePadded  = iniConfig.get<int>("Time.WindowSizePadded");
+    const int windowSkipping    = iniConfig.get<int>("Time.WindowSkipping");
+    const float threshold       = iniConfig.get<float>("Whistle.Threshold");
+    const unsigned okayFrames   = iniConfig.get<unsigned>("Whistle.FrameOkays");
+    const unsigned missFrames   = iniConfig.get<unsigned>("Whistle.FrameMisses");
+    const int periodSize        = iniConfig.get<int>("Capture.PeriodSize", BUFFER_SIZE_RX);
+    const short captureChannels = iniConfig.get<short>("Capture.Channels", NUM_CHANNELS_RX);
+    const std::string kernels   = iniConfig.get<std::string>("Engine.Kernels", "auto");
+
+    if(!FixedFFT::isSupported(windowSizePadded)) {
+        std::cerr << "The fixed engine needs a padded window of twice a product of 2, 3 and 5 samples!" << std::endl;
+        return 1;
+    }
+    if(!selectKernels(kernels)) {
+        std::cerr << "Kernels " << kernels << " are not supported!" << std::endl;
+        return 1;
+    }
+
+    FileSource file(AudioSource::Handler(), argv[1], periodSize, captureChannels, sampleRate);
+    if(!file.openFile()) {
+        return 1;
+    }
+    if(file.getSampleRate() != sampleRate) {
+        std::cerr << argv[1] << " is recorded at " << file.getSampleRate() << " Hz, not at " << sampleRate << " Hz!" << std::endl;
+        return 1;
+    }
+
+    const int binBegin = (whistleBegin * windowSizePadded) / sampleRate;
+    const int binEnd   = (whistleEnd * windowSizePadded) / sampleRate;
+    Detector floatDetector(binBegin, binEnd, threshold, okayFrames, missFrames);
+    Detector fixedDetector(binBegin, binEnd, threshold, okayFrames, missFrames);
+    Decisions floatDecisions, fixedDecisions;
+
+    STFT stft(0, windowSize, windowSkipping, windowSizePadded, [&] (const float *spectrum, int length) {
+        float mean, dev;
+        calcMeanDeviation(spectrum, length, mean, dev);
+        floatDecisions.frames.push_back(floatDetector.isAbove(spectrum + binBegin, mean, dev));
+        if(floatDetector.handleBand(spectrum + binBegin, mean, dev)) {
+            floatDecisions.onsets.push_back(floatDetector.getOnsetFrame());
+        }
+    });
+    FixedSTFT fixedStft(0, windowSize, windowSkipping, windowSizePadded, [&] (const uint32_t *spectrum, int length) {
+        FixedSpectrumStatistics stats = {0, 0, 0, 0};
+        calcFixedStatistics(spectrum, length, stats);
+        fixedDecisions.frames.push_back(fixedDetector.isAbove(spectrum + binBegin, stats));
+        if(fixedDetector.handleFixedBand(spectrum + binBegin, stats)) {
+            fixedDecisions.onsets.push_back(fixedDetector.getOnsetFrame());
+        }
+    });
+
+    /* the same buffers as a replay */
+    const int16_t *samples = file.getSamples();
+    const short channels = file.getChannels();
+    for(long frame = 0; frame < file.getFrames(); frame += periodSize) {
+        const int length = static_cast<int>(std::min<long>(periodSize, file.getFrames() - frame));
+        stft.newData(samples + frame * channels, length, channels);
+        fixedStft.newData(samples + frame * channels, length, channels);
+    }
+
+    size_t differing = 0;
+    for(size_t i = 0; i < floatDecisions.frames.size(); ++i) {
+        if(floatDecisions.frames[i] != fixedDecisions.frames[i]) {
+            if(differing < 10) {
+                std::cout << "Frame " << i << ": float " << (floatDecisions.frames[i] ? "above" : "below")
+                          << " the threshold, fixed " << (fixedDecisions.frames[i] ? "above" : "below") << std::endl;
+            }
+            ++differing;
+        }
+    }
+    std::cout << floatDecisions.frames.size() << " frames with " << kernelName() << " kernels, "
+              << differing << " frame decision(s) differ." << std::endl;
+    std::cout << "Float: " << floatDecisions.onsets.size() << " whistle(s), fixed: "
+              << fixedDecisions.onsets.size() << " whistle(s)." << std::endl;
+
+    if(floatDecisions.onsets != fixedDecisions.onsets) {
+        printMissing("float", floatDecisions.onsets, fixedDecisions.onsets);
+        printMissing("fixed", fixedDecisions.onsets, floatDecisions.onsets);
+        std::cout << "The detections differ!" << std::endl;
+        return 1;
+    }
+    std::cout << "The detections are the same." << std::endl;
+    return 0;
+}
@@ -0,0 +1,98 @@
+// reads the live spectra a running whistle detector publishes ([Publish] Enabled) and prints a line per second
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <time.h>
+
+#include "SpectrumShm.h"
+
+static volatile sig_atomic_t stopped = 0;
+
+static void stop(int)
+{
+    stopped = 1;
+}
+
+static uint64_t now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+/* usage: whistle_detector_listen [name [seconds]], seconds: 0 runs until interrupted */
+int main(int argc, char **argv)
+{
+    signal(SIGINT,  &stop);
+    signal(SIGTERM, &stop);
+
+    SpectrumSubscriber spectra((argc > 1) ? argv[1] : SPECTRUM_SHM_NAME);
+    const double seconds = (argc > 2) ? atof(argv[2]) : 0.0;
+    const uint64_t end = seconds > 0.0 ? now() + static_cast<uint64_t>(seconds * 1e9) : 0;
+
+    uint64_t total = 0, report = now() + 1000000000ull;
+    uint64_t count = 0, latency = 0, maxLatency = 0, gaps = 0;
+    float peak = 0.0f, peakFrequency = 0.0f;
+    while(!stopped && (!end || now() < end)) {
+        if(!spectra.isPublishing()) {
+            /* not started yet, or a new ring after a restart */
+            spectra.close();
+            if(!spectra.open()) {
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                continue;
+            }
+            const SpectrumShmHeader &header = spectra.getHeader();
+            std::cout << "Listening to " << header.bins << " bins every " << header.hop << " samples at "
+                      << header.sampleRate << " Hz, " << header.slots << " slots." << std::endl;
+        }
+
+        uint64_t sequence, timestamp;
+        const float *spectrum;
+        while((spectrum = spectra.next(sequence, timestamp)) != NULL) {
+            /* in place: the loudest bin, valid only if the slot was not overwritten meanwhile */
+            int loudest = 0;
+            for(int i = 1; i < spectra.getBins(); ++i) {
+                if(spectrum[i] > spectrum[loudest]) {
+                    loudest = i;
+                }
+            }
+            const float magnitude = spectrum[loudest];
+            const uint32_t flags = spectra.getFlags();
+            if(!spectra.isValid()) {
+                continue;
+            }
+            if(flags & SPECTRUM_SLOT_GAP) {
+                ++gaps;
+            }
+            const uint64_t delay = now() - timestamp;
+            latency += delay;
+            maxLatency = std::max(maxLatency, delay);
+            if(magnitude > peak) {
+                peak = magnitude;
+                peakFrequency = loudest * spectra.getBinFrequency();
+            }
+            ++count;
+        }
+
+        if(now() >= report) {
+            total += count;
+            std::cout << count << " spectra/s, loudest " << peakFrequency << " Hz, latency "
+                      << (count ? latency / count / 1000 : 0) << " us (max " << maxLatency / 1000 << " us), "
+                      << spectra.getLost() << " lost, " << gaps << " gap(s)" << std::endl;
+            count = latency = maxLatency = gaps = 0;
+            peak = peakFrequency = 0.0f;
+            report += 1000000000ull;
+        }
+        /* a few polls per spectrum */
+        const SpectrumShmHeader &header = spectra.getHeader();
+        std::this_thread::sleep_for(std::chrono::microseconds(250000ull * header.hop / header.sampleRate));
+    }
+    total += count;
+    std::cout << total << " spectra read, " << spectra.getLost() << " lost." << std::endl;
+    return 0;
+}
@@ -4,36 +4,196 @@
  */
 
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 
 #include "SoundConfig.h"
 #include "ALSARecorder.h"
+#include "ConfigWatcher.h"
+#include "FileSource.h"
+#include "Decimator.h"
+#include "Detector.h"
+#include "EnergyGate.h"
+#include "EventDispatcher.h"
+#include "FixedSTFT.h"
+#include "Goertzel.h"
+#include "Kernels.h"
+#include "MultiChannelSTFT.h"
+#include "Planner.h"
+#include "PreTriggerRecorder.h"
+#include "Spectrogram.h"
+#include "SpectrumShm.h"
+#include "StreamEngine.h"
 #include "STFT.h"
+#include "StaticSTFT.h"
+#include "Timing.h"
+
+/* another whistle detected in the same spectra, section [Whistle.<name>] */
+struct WhistleProfile {
+    std::string name;
+    float fWhistleBegin, fWhistleEnd;
+    int nWhistleBegin, nWhistleEnd;
+    float vWhistleThreshold;
+    unsigned nWhistleMissFrames, nWhistleOkayFrames;
+};
 
 struct ProcessingRecord {
     float fWhistleBegin, fWhistleEnd;
     int nWhistleBegin, nWhistleEnd;
-    int fSampleRate;
+    int fSampleRate;            /* of the transforms, the capture may run at a multiple */
+    int nDecimation;            /* capture frames per processed frame */
     int nWindowSize, nWindowSizePadded;
     int nWindowSkipping;
     float vDeviationMultiplier;
     float vWhistleThreshold;
     unsigned nWhistleMissFrames, nWhistleOkayFrames;
+    std::vector<WhistleProfile> profiles;   /* besides the [Whistle] one */
+    std::string sNoiseFloor;    /* frame, ema or percentile */
+    NoiseFloorMode noiseFloor;
+    int nNoiseFrames;
+    float vNoisePercentile;
+    std::string sEngine;        /* fft, goertzel or fixed (Q15, integer threshold test) */
+    bool bBatched;
+    bool bStatic;               /* compile time specialized transform for the window presets */
+    std::string sKernels;       /* auto, scalar, sse2, ssse3, avx2 or neon */
+    std::string sFusion;        /* none (channel 0), max, power or delaysum */
+    FusionMode fusion;
+    std::string sFusionDelays;  /* per channel in samples, separated by spaces or commas */
+    std::vector<float> vFusionDelays;
+    bool bGate;                 /* transform only buffers with energy in the whistle band */
+    float vGateThreshold;       /* dB above the floor */
+    float fGatePreRoll, fGateHold, fGateAdaptation;
+    int nGatePreRoll, nGateHold, nGateAdaptation;
+    CaptureConfig capture;
+    std::string sInputFile;     /* replay this recording instead of capturing */
+    bool bTiming;               /* per stage timing and detection latency */
+    std::string sWisdomFile;    /* FFTW wisdom, empty: none */
+    bool bBackgroundPlanning;   /* estimate plans without wisdom, measure them in the background */
+    std::string sSpectrogramFile;   /* cache the spectra of this run, empty: off */
+    std::string sSpectrogramFormat; /* float or float16 */
+    float fSpectrogramBegin, fSpectrogramEnd;
+    int nSpectrogramBegin, nSpectrogramEnd;
+    bool bWatchConfig;          /* reload when the config file changes */
+    bool bAsyncEvents;          /* whistleAction on a dispatcher thread instead of the audio thread */
+    int nEventQueue;
+    float fEventCoalesce;       /* s */
+    bool bRecorder;             /* keep the last seconds of capture, dump them around every whistle */
+    std::string sRecorderDirectory;
+    float fRecorderSeconds, fRecorderBefore, fRecorderAfter;
+    bool bRecorderSpectra;      /* the spectra of the dumped audio as well */
+    bool bPublish;              /* every spectrum into shared memory for other processes */
+    std::string sPublishName;
+    int nPublishSlots;
 };
 
-int executeAction(const ProcessingRecord &config, void (*whistleAction)(void));
-int runFrequencyExtraction(ProcessingRecord &config, void (*whistleAction)(void));
+/* everything between the capture and whistleAction, rebuilt off the audio thread on reload */
+struct Pipeline {
+    Pipeline(const ProcessingRecord &config, const WhistleHandler &whistleAction, SpectrogramWriter *spectrogram,
+             PreTriggerRecorder *recorder, SpectrumPublisher *publisher);
+    ~Pipeline();
+
+    /* one buffer through the gate, the transform and the detector */
+    void process(const int16_t *data, int length, short channels);
+    /* one buffer through the transform and the detector */
+    void transform(const int16_t *data, int length, short channels)
+    {
+        if(staticStft) {
+            staticStft->newData(data, length, channels);
+        } else {
+            newData(data, length, channels);
+        }
+    }
+    /* the next buffer does not continue the windows of the last one */
+    void restart();
+    /* the stream was interrupted (capture suspended): no window, pre-roll or whistle continues */
+    void startOver();
+    /* keeps the last window of samples */
+    void remember(const int16_t *data, int length, short channels);
+    /* continues where previous stopped, frame: capture frame of the next sample */
+    void takeOver(const Pipeline &previous, uint64_t frame, short channels);
+    /* samples before frame the transform keeps for its next window */
+    int pendingFrames(uint64_t frame) const;
+
+    const ProcessingRecord config;
+    std::vector<Detector> detectors;    /* [Whistle] first, then the profiles, all on the same spectra */
+    STFT *stft;
+    MultiChannelSTFT *multiStft;
+    FixedSTFT *fixedStft;
+    Goertzel *goertzel;
+    StaticSTFTBase *staticStft;
+    AudioSource::Handler newData;   /* one of the transforms */
+    EnergyGate *gate;
+    SpectrumPublisher *spectrumPublisher;  /* NULL unless the spectra are published */
+
+    uint64_t firstFrame;        /* frame of the first sample transformed since the last restart */
+    uint64_t firstWindow;       /* detector frame of its window */
+    uint64_t nextFrame;         /* frame of the next sample fed */
+    const int historyFrames;
+    int historyFill;
+    std::vector<int16_t> history;
+};
+
+/* runs on the audio thread: switches to a reloaded pipeline between two buffers */
+struct PipelineSwitch {
+    PipelineSwitch(Pipeline *pipeline, const ProcessingRecord &config, PreTriggerRecorder *recorder);
+    ~PipelineSwitch();
+
+    /* captured frames, decimated to the processing rate */
+    void newData(const int16_t *data, int length, short channels);
+    /* frames at the processing rate */
+    void process(const int16_t *data, int length, short channels);
+    /* the capture was suspended, the next buffer starts a new stream */
+    void restart();
+
+    Pipeline *pipeline;
+    uint64_t processedFrames;
+    PreTriggerRecorder *recorder;
+
+    Decimator *decimator;
+    std::vector<int16_t> decimated;
+};
+
+int executeAction(const ProcessingRecord &config, const WhistleHandler &whistleAction);
+int replaySpectrogram(const ProcessingRecord &config, const WhistleHandler &whistleAction);
+int executeStreams(const ProcessingRecord &config, const std::vector<std::string> &inputFiles, int threads);
+int prepareExtraction(ProcessingRecord &config);
+int runFrequencyExtraction(ProcessingRecord &config, const WhistleHandler &whistleAction);
 void stopListening(int signal);
 void setListeningPaused(bool paused);
+std::string getCaptureStatistics();
+std::string getTimingReport();
+bool reloadConfig();
+bool dumpRecording();
+void resetTiming();
 
-static AlsaRecorder *reader = NULL;
+#define RELOAD_TIMEOUT_MS   (1000)
 
-int main_loop(const std::string& configFile, void (*whistleAction)(void)) {
+static AudioSource *reader = NULL;
 
-    ProcessingRecord config;
+/* hot reload: pipelines are built by reloadConfig, the audio thread picks up the pending one
+ * between two buffers and publishes it as active, the others are deleted by the next reload */
+static std::mutex reloadMutex;
+static std::string configPath;
+static ProcessingRecord activeConfig;
+static WhistleHandler activeAction;
+static SpectrogramWriter *spectrogram = NULL;
+static PreTriggerRecorder *dumpRecorder = NULL;
+static SpectrumPublisher *publisher = NULL;
+static std::vector<Pipeline*> pipelines;
+static std::atomic<Pipeline*> activePipeline(NULL), pendingPipeline(NULL);
+
+static void readConfig(const std::string& configFile, ProcessingRecord &config)
+{
     boost::property_tree::ptree iniConfig;
     boost::property_tree::ini_parser::read_ini(configFile, iniConfig);
 
@@ -48,6 +208,90 @@ int main_loop(const std::string& configFile, void (*whistleAction)(void)) {
     config.vWhistleThreshold        = iniConfig.get<float>("Whistle.Threshold");
     config.nWhistleOkayFrames       = iniConfig.get<unsigned>("Whistle.FrameOkays");
     config.nWhistleMissFrames       = iniConfig.get<unsigned>("Whistle.FrameMisses");
+    config.sNoiseFloor              = iniConfig.get<std::string>("Whistle.NoiseFloor", "frame");
+    config.nNoiseFrames             = iniConfig.get<int>("Whistle.NoiseFrames", 100);
+    config.vNoisePercentile         = iniConfig.get<float>("Whistle.NoisePercentile", 0.5f);
+
+    /* the section names contain the path separator, so they are looked up by hand */
+    for(boost::property_tree::ptree::const_iterator it = iniConfig.begin(); it != iniConfig.end(); ++it) {
+        if(it->first.compare(0, 8, "Whistle.") != 0) {
+            continue;
+        }
+        const boost::property_tree::ptree &section = it->second;
+        WhistleProfile profile;
+        profile.name                = it->first.substr(8);
+        profile.fWhistleBegin       = section.get<float>("WhistleBegin", config.fWhistleBegin);
+        profile.fWhistleEnd         = section.get<float>("WhistleEnd", config.fWhistleEnd);
+        profile.vWhistleThreshold   = section.get<float>("Threshold", config.vWhistleThreshold);
+        profile.nWhistleOkayFrames  = section.get<unsigned>("FrameOkays", config.nWhistleOkayFrames);
+        profile.nWhistleMissFrames  = section.get<unsigned>("FrameMisses", config.nWhistleMissFrames);
+        config.profiles.push_back(profile);
+    }
+
+    config.sEngine                  = iniConfig.get<std::string>("Engine.Type", "fft");
+    config.bBatched                 = iniConfig.get<bool>("Engine.Batched", false);
+    config.bStatic                  = iniConfig.get<bool>("Engine.Static", false);
+    config.sKernels                 = iniConfig.get<std::string>("Engine.Kernels", "auto");
+    config.sFusion                  = iniConfig.get<std::string>("Engine.Fusion", "none");
+    config.sFusionDelays            = iniConfig.get<std::string>("Engine.FusionDelays", "");
+
+    config.bGate                    = iniConfig.get<bool>("Gate.Enabled", false);
+    config.vGateThreshold           = iniConfig.get<float>("Gate.Threshold", 6.0f);
+    config.fGatePreRoll             = iniConfig.get<float>("Gate.PreRoll", 0.1f);
+    config.fGateHold                = iniConfig.get<float>("Gate.Hold", 0.5f);
+    config.fGateAdaptation          = iniConfig.get<float>("Gate.Adaptation", 2.0f);
+
+    CaptureConfig &capture          = config.capture;
+    capture.device                  = iniConfig.get<std::string>("Capture.Device", capture.device);
+    capture.mixerDevice             = iniConfig.get<std::string>("Capture.MixerDevice", capture.mixerDevice);
+    capture.mixerElement            = iniConfig.get<std::string>("Capture.MixerElement", capture.mixerElement);
+    capture.channels                = iniConfig.get<short>("Capture.Channels", capture.channels);
+    capture.sampleRate              = iniConfig.get<unsigned>("Capture.SampleRate", config.fSampleRate);
+    capture.periodSize              = iniConfig.get<int>("Capture.PeriodSize", capture.periodSize);
+    capture.periods                 = iniConfig.get<unsigned>("Capture.Periods", capture.periods);
+    capture.ringFrames              = iniConfig.get<int>("Capture.RingBuffer", capture.ringFrames);
+    capture.mmap                    = iniConfig.get<bool>("Capture.Mmap", capture.mmap);
+    capture.realtimePriority        = iniConfig.get<int>("Capture.RealtimePriority", capture.realtimePriority);
+    capture.cpu                     = iniConfig.get<int>("Capture.Cpu", capture.cpu);
+    capture.lockMemory              = iniConfig.get<bool>("Capture.LockMemory", capture.lockMemory);
+
+    config.bTiming                  = iniConfig.get<bool>("Timing.Enabled", false);
+
+    config.sWisdomFile              = iniConfig.get<std::string>("FFTW.Wisdom", "");
+    config.bBackgroundPlanning      = iniConfig.get<bool>("FFTW.BackgroundPlanning", true);
+
+    config.sSpectrogramFile         = iniConfig.get<std::string>("Spectrogram.File", "");
+    config.sSpectrogramFormat       = iniConfig.get<std::string>("Spectrogram.Format", "float");
+    config.fSpectrogramBegin        = iniConfig.get<float>("Spectrogram.Begin", 0.0f);
+    config.fSpectrogramEnd          = iniConfig.get<float>("Spectrogram.End", config.fSampleRate / 2.0f);
+
+    config.bWatchConfig             = iniConfig.get<bool>("Reload.Watch", false);
+
+    config.bAsyncEvents             = iniConfig.get<bool>("Events.Async", false);
+    config.nEventQueue              = iniConfig.get<int>("Events.Queue", 16);
+    config.fEventCoalesce           = iniConfig.get<float>("Events.Coalesce", 0.5f);
+
+    config.bRecorder                = iniConfig.get<bool>("Recorder.Enabled", false);
+    config.sRecorderDirectory       = iniConfig.get<std::string>("Recorder.Directory", "/home/nao/whistle_dumps");
+    config.fRecorderSeconds         = iniConfig.get<float>("Recorder.Seconds", 10.0f);
+    config.fRecorderBefore          = iniConfig.get<float>("Recorder.Before", 4.0f);
+    config.fRecorderAfter           = iniConfig.get<float>("Recorder.After", 1.0f);
+    config.bRecorderSpectra         = iniConfig.get<bool>("Recorder.Spectra", false);
+
+    config.bPublish                 = iniConfig.get<bool>("Publish.Enabled", false);
+    config.sPublishName             = iniConfig.get<std::string>("Publish.Name", SPECTRUM_SHM_NAME);
+    config.nPublishSlots            = iniConfig.get<int>("Publish.Slots", 64);
+}
+
+int main_events(const std::string& configFile, const std::string& inputFile, const WhistleHandler &whistleAction) {
+
+    ProcessingRecord config;
+    readConfig(configFile, config);
+    config.sInputFile               = inputFile;
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        configPath                  = configFile;
+    }
 
     std::cout << "---------------------------------------------------" << std::endl
               << "--- Whistle Detection                           ---" << std::endl
@@ -65,8 +309,40 @@ int main_loop(const std::string& configFile, void (*whistleAction)(void)) {
     return result;
 }
 
-int runFrequencyExtraction(ProcessingRecord &config, void (*whistleAction)(void))
+int main_loop(const std::string& configFile, const std::string& inputFile, void (*whistleAction)(void)) {
+    return main_events(configFile, inputFile, [whistleAction] (const WhistleEvent&) { whistleAction(); });
+}
+
+int main_loop(const std::string& configFile, void (*whistleAction)(void)) {
+    return main_loop(configFile, std::string(), whistleAction);
+}
+
+int main_streams(const std::string& configFile, const std::vector<std::string>& inputFiles, int threads) {
+
+    ProcessingRecord config;
+    readConfig(configFile, config);
+
+    if(prepareExtraction(config) != 0) {
+        return -1;
+    }
+    return executeStreams(config, inputFiles, threads);
+}
+
+int runFrequencyExtraction(ProcessingRecord &config, const WhistleHandler &whistleAction)
+{
+    if(prepareExtraction(config) != 0) {
+        return -1;
+    }
+
+    executeAction(config, whistleAction);
+
+    return 0;
+}
+
+int prepareExtraction(ProcessingRecord &config)
 {
+    config.nDecimation = config.fSampleRate > 0 ? static_cast<int>(config.capture.sampleRate) / config.fSampleRate : 0;
+
     /* load window times */
     config.nWhistleBegin = (config.fWhistleBegin * config.nWindowSizePadded) / config.fSampleRate;
     config.nWhistleEnd  = (config.fWhistleEnd  * config.nWindowSizePadded)   / config.fSampleRate;
@@ -80,6 +356,14 @@ int runFrequencyExtraction(ProcessingRecord &config, void (*whistleAction)(void)
                 << "  Real Window:      " << config.nWindowSize            << " bins" << std::endl
                 << "  Padded Window:    " << config.nWindowSizePadded      << " bins" << std::endl
                 << "  Window Skip:      " << config.nWindowSkipping        << " samples" << std::endl
+                << "  Engine:           " << config.sEngine << (config.bBatched ? " (batched)" : "")
+                                          << (config.bStatic ? " (static)" : "") << std::endl
+                << "  Capture:          " << config.capture.device << ", " << config.capture.channels << " channel(s), "
+                                          << config.capture.periodSize << " frames per period, " << config.capture.sampleRate << " Hz";
+    if(config.nDecimation > 1) {
+        std::cout << " decimated by " << config.nDecimation;
+    }
+    std::cout   << std::endl
                 << "---------------------------------------------------"   << std::endl
                 << "  Whistle Begin:    " << fWhistleBegin                 << " Hz" << std::endl
                 << "  Whistle End:      " << fWhistleEnd                   << " Hz" << std::endl;
@@ -106,8 +390,152 @@ int runFrequencyExtraction(ProcessingRecord &config, void (*whistleAction)(void)
         std::cerr << "Whistle begin is above Whistle end!" << std::endl;
         return -1;
     }
+    unsigned maxMissFrames = config.nWhistleMissFrames;
+    for(size_t i = 0; i < config.profiles.size(); ++i) {
+        WhistleProfile &profile = config.profiles[i];
+        profile.nWhistleBegin = (profile.fWhistleBegin * config.nWindowSizePadded) / config.fSampleRate;
+        profile.nWhistleEnd   = (profile.fWhistleEnd   * config.nWindowSizePadded) / config.fSampleRate;
+        if(profile.name.empty() || profile.name.size() >= sizeof(WhistleEvent().profile)) {
+            std::cerr << "Whistle profile names need 1 to " << sizeof(WhistleEvent().profile) - 1 << " characters!" << std::endl;
+            return -1;
+        }
+        if(profile.fWhistleBegin < 0 || profile.fWhistleEnd > (config.fSampleRate / 2) || profile.nWhistleBegin >= profile.nWhistleEnd) {
+            std::cerr << "Whistle profile " << profile.name << " has no band between zero and the Nyquist frequency!" << std::endl;
+            return -1;
+        }
+        for(size_t k = 0; k < i; ++k) {
+            if(config.profiles[k].name == profile.name) {
+                std::cerr << "Whistle profile " << profile.name << " is defined twice!" << std::endl;
+                return -1;
+            }
+        }
+        std::cout << "  Profile " << profile.name << ":" << std::string(profile.name.size() < 9 ? 9 - profile.name.size() : 1, ' ')
+                  << (profile.nWhistleBegin * static_cast<float>(config.fSampleRate)) / config.nWindowSizePadded << " - "
+                  << (profile.nWhistleEnd * static_cast<float>(config.fSampleRate)) / config.nWindowSizePadded << " Hz, threshold "
+                  << profile.vWhistleThreshold << std::endl;
+        maxMissFrames = std::max(maxMissFrames, profile.nWhistleMissFrames);
+    }
+    if(config.sEngine != "fft" && config.sEngine != "goertzel" && config.sEngine != "fixed") {
+        std::cerr << "Unknown engine " << config.sEngine << "!" << std::endl;
+        return -1;
+    }
+    if(config.sEngine == "fixed" && !FixedFFT::isSupported(config.nWindowSizePadded)) {
+        std::cerr << "The fixed engine needs a padded window of twice a product of 2, 3 and 5 samples!" << std::endl;
+        return -1;
+    }
+    if(!parseFusionMode(config.sFusion, config.fusion)) {
+        std::cerr << "Unknown fusion " << config.sFusion << "!" << std::endl;
+        return -1;
+    }
+    if(config.fusion != FUSION_NONE && config.sEngine != "fft") {
+        std::cerr << "Channel fusion needs the fft engine!" << std::endl;
+        return -1;
+    }
+    {
+        std::string delays = config.sFusionDelays;
+        std::replace(delays.begin(), delays.end(), ',', ' ');
+        std::istringstream in(delays);
+        config.vFusionDelays.clear();
+        float delay;
+        while(in >> delay) {
+            config.vFusionDelays.push_back(delay);
+        }
+        if(!in.eof() || (!config.vFusionDelays.empty() && static_cast<int>(config.vFusionDelays.size()) != config.capture.channels)) {
+            std::cerr << "Fusion delays need one number per channel!" << std::endl;
+            return -1;
+        }
+    }
+    if(config.nDecimation < 1 || static_cast<int>(config.capture.sampleRate) != config.nDecimation * config.fSampleRate) {
+        std::cerr << "The capture sample rate must be a multiple of the sample rate!" << std::endl;
+        return -1;
+    }
+    if(config.capture.channels <= 0 || config.capture.periodSize <= 0) {
+        std::cerr << "Capture channels and period size must be positive!" << std::endl;
+        return -1;
+    }
+    if(!parseNoiseFloorMode(config.sNoiseFloor, config.noiseFloor)) {
+        std::cerr << "Unknown noise floor " << config.sNoiseFloor << "!" << std::endl;
+        return -1;
+    }
+    if(config.noiseFloor != NOISE_FLOOR_FRAME && config.nNoiseFrames < 2) {
+        std::cerr << "Noise frames must be at least 2!" << std::endl;
+        return -1;
+    }
+    std::cout   << "  Noise floor:      " << noiseFloorName(config.noiseFloor);
+    if(config.noiseFloor != NOISE_FLOOR_FRAME) {
+        std::cout << " over " << config.nNoiseFrames << " frames";
+    }
+    std::cout   << std::endl;
+    /* the pre-roll holds at least one window, the hold lets the detector see a whistle end */
+    config.nGatePreRoll    = std::max(config.nWindowSize, static_cast<int>(config.fGatePreRoll * config.fSampleRate));
+    config.nGateHold       = std::max(static_cast<int>((maxMissFrames + 2) * config.nWindowSkipping) + config.nWindowSize,
+                                      static_cast<int>(config.fGateHold * config.fSampleRate));
+    config.nGateAdaptation = static_cast<int>(config.fGateAdaptation * config.fSampleRate);
+    if(config.bGate) {
+        if(config.fGateAdaptation <= 0.0f) {
+            std::cerr << "Gate adaptation must be positive!" << std::endl;
+            return -1;
+        }
+        std::cout << "  Gate:             " << config.vGateThreshold << " dB, " << config.nGatePreRoll << " frames pre-roll, "
+                  << config.nGateHold << " frames hold" << std::endl;
+    }
+    if(!selectKernels(config.sKernels)) {
+        std::cerr << "Kernels " << config.sKernels << " are not supported!" << std::endl;
+        return -1;
+    }
+    if(config.fusion != FUSION_NONE) {
+        std::cout << "  Fusion:           " << fusionName(config.fusion) << " of " << config.capture.channels << " channel(s)" << std::endl;
+    }
+    std::cout   << "  Kernels:          " << kernelName() << std::endl;
+    std::cout   << "  Timing:           " << (config.bTiming ? "on" : "off") << std::endl;
+    if(config.bAsyncEvents && config.nEventQueue <= 0) {
+        std::cerr << "The event queue must hold at least one event!" << std::endl;
+        return -1;
+    }
+    std::cout   << "  Events:           " << (config.bAsyncEvents ? "async" : "on the audio thread") << std::endl;
+    if(config.bRecorder) {
+        if(config.fRecorderBefore < 0.0f || config.fRecorderAfter < 0.0f
+           || config.fRecorderBefore + config.fRecorderAfter >= config.fRecorderSeconds) {
+            std::cerr << "The recorder has to keep more than Before + After seconds!" << std::endl;
+            return -1;
+        }
+        std::cout << "  Recorder:         " << config.fRecorderSeconds << " s kept, " << config.fRecorderBefore << " s before and "
+                  << config.fRecorderAfter << " s after a whistle to " << config.sRecorderDirectory
+                  << (config.bRecorderSpectra ? " (with spectra)" : "") << std::endl;
+    }
+    if(config.bPublish) {
+        if(config.sPublishName.size() < 2 || config.sPublishName[0] != '/'
+           || config.sPublishName.find('/', 1) != std::string::npos || config.nPublishSlots < 2) {
+            std::cerr << "Publishing needs a name like /whistle_spectrum and at least 2 slots!" << std::endl;
+            return -1;
+        }
+        std::cout << "  Publish:          " << config.sPublishName << ", " << config.nPublishSlots << " spectra" << std::endl;
+    }
 
-    executeAction(config, whistleAction);
+    /* stored bins, the whole range of both frequencies */
+    const int nBins = config.nWindowSizePadded / 2 + 1;
+    config.nSpectrogramBegin = std::max(0, static_cast<int>((config.fSpectrogramBegin * config.nWindowSizePadded) / config.fSampleRate));
+    config.nSpectrogramEnd   = std::min(nBins, static_cast<int>((config.fSpectrogramEnd * config.nWindowSizePadded) / config.fSampleRate) + 1);
+    if(!config.sSpectrogramFile.empty()) {
+        if(config.sSpectrogramFormat != "float" && config.sSpectrogramFormat != "float16") {
+            std::cerr << "Unknown spectrogram format " << config.sSpectrogramFormat << "!" << std::endl;
+            return -1;
+        }
+        if(config.nSpectrogramBegin >= config.nSpectrogramEnd) {
+            std::cerr << "Spectrogram begin is above Spectrogram end!" << std::endl;
+            return -1;
+        }
+        std::cout << "  Spectrogram:      " << config.sSpectrogramFile << " (" << config.sSpectrogramFormat << ", bins "
+                  << config.nSpectrogramBegin << " - " << config.nSpectrogramEnd << ")" << std::endl;
+    }
+    std::cout   << "---------------------------------------------------"   << std::endl;
+
+    setPlanning(config.sWisdomFile, config.bBackgroundPlanning);
+    if(!config.sWisdomFile.empty()) {
+        importWisdom(config.sWisdomFile);
+    }
+
+    Timing::setEnabled(config.bTiming);
 
     return 0;
 }
@@ -127,76 +555,817 @@ void setListeningPaused(bool paused) {
     }
 }
 
-int executeAction(const ProcessingRecord &config, void (*whistleAction)(void))
+std::string getCaptureStatistics()
 {
-    auto calcMeanDeviation = [&] (const float *data, int length, float &mean, float &dev) {
-        mean = dev = 0;
-        for(int i = 0; i < length; ++i) {
-            mean    += data[i];
-            dev     += data[i] * data[i];
+    std::ostringstream out;
+    AlsaRecorder *recorder = dynamic_cast<AlsaRecorder*>(reader);
+    if(recorder) {
+        out << "ring fill " << recorder->getRingFill() << " frames (max " << recorder->getRingMaxFill() << "), "
+            << recorder->getOverruns() << " overruns, " << recorder->getDroppedFrames() << " frames dropped";
+        if(recorder->getResumeLatency()) {
+            out << ", resumed in " << recorder->getResumeLatency() / 1000 << " us";
         }
+    }
+    return out.str();
+}
+
+std::string getTimingReport()
+{
+    return Timing::report();
+}
 
-        dev = std::sqrt(length * dev - mean * mean) / length;
-        mean /= length;
+void resetTiming()
+{
+    Timing::reset();
+}
+
+Pipeline::Pipeline(const ProcessingRecord &config, const WhistleHandler &whistleAction, SpectrogramWriter *spectrogram,
+                   PreTriggerRecorder *recorder, SpectrumPublisher *publisher)
+    : config(config),
+      stft(NULL), multiStft(NULL), fixedStft(NULL), goertzel(NULL), staticStft(NULL), gate(NULL), spectrumPublisher(NULL),
+      firstFrame(0), firstWindow(0), nextFrame(0),
+      historyFrames(config.bGate ? std::max(config.nWindowSize, config.nGatePreRoll) : config.nWindowSize), historyFill(0),
+      history(static_cast<size_t>(historyFrames) * config.capture.channels, 0)
+{
+    detectors.reserve(config.profiles.size() + 1);
+    detectors.emplace_back(config.nWhistleBegin, config.nWhistleEnd, config.vWhistleThreshold,
+                           config.nWhistleOkayFrames, config.nWhistleMissFrames);
+    int bandBegin = config.nWhistleBegin, bandEnd = config.nWhistleEnd;
+    float fBandBegin = config.fWhistleBegin, fBandEnd = config.fWhistleEnd;
+    for(size_t i = 0; i < config.profiles.size(); ++i) {
+        const WhistleProfile &profile = config.profiles[i];
+        detectors.emplace_back(profile.nWhistleBegin, profile.nWhistleEnd, profile.vWhistleThreshold,
+                               profile.nWhistleOkayFrames, profile.nWhistleMissFrames);
+        bandBegin = std::min(bandBegin, profile.nWhistleBegin);
+        bandEnd = std::max(bandEnd, profile.nWhistleEnd);
+        fBandBegin = std::min(fBandBegin, profile.fWhistleBegin);
+        fBandEnd = std::max(fBandEnd, profile.fWhistleEnd);
+    }
+    for(size_t i = 0; i < detectors.size(); ++i) {
+        detectors[i].setNoiseFloor(config.noiseFloor, config.nNoiseFrames, config.vNoisePercentile);
+    }
+
+    /* the onset window is complete with its last sample */
+    auto whistleDetected = [this, whistleAction] (size_t profile) {
+        const Detector &detector = detectors[profile];
+        const uint64_t onsetFrame = (this->firstFrame + (detector.getOnsetFrame() - this->firstWindow) * this->config.nWindowSkipping
+                                     + this->config.nWindowSize) * this->config.nDecimation;
+        Timing::recordLatency(onsetFrame);
+
+        WhistleEvent event;
+        event.detected   = Timing::now();
+        event.onset      = Timing::isEnabled() ? Timing::captureTime(onsetFrame) : 0;
+        event.position   = onsetFrame * 1000000000ull / this->config.capture.sampleRate;
+        event.confidence = detector.getConfidence();
+        event.count      = 1;
+        /* no allocation on the audio thread, the names fit (checked by prepareExtraction) */
+        strncpy(event.profile, profile ? this->config.profiles[profile - 1].name.c_str() : "", sizeof(event.profile) - 1);
+        event.profile[sizeof(event.profile) - 1] = '\0';
+        StageTimer timer(TIMING_ACTION);
+        whistleAction(event);
     };
 
-    /* start fft stuff */
-    auto handleSpectrum = [&] (const float *spectrum, int length) {
-        static unsigned whistleCounter(0), whistleMissCounter(0), whistleDone(false);
+    /* start fft stuff, the statistics of a spectrum are shared by all profiles */
+    auto handleSpectrum = [this, whistleDetected] (const float *spectrum, int length) {
+        float mean = 0.0f, dev = 0.0f;
+        if(this->config.noiseFloor == NOISE_FLOOR_FRAME) {
+            calcMeanDeviation(spectrum, length, mean, dev);
+        }
+        for(size_t i = 0; i < detectors.size(); ++i) {
+            if(detectors[i].handleBand(spectrum + detectors[i].getBinBegin(), mean, dev)) {
+                whistleDetected(i);
+            }
+        }
+    };
+
+    /* same detection, one call for all windows of a buffer */
+    auto handleSpectra = [handleSpectrum] (const float *spectra, int length, int count) {
+        for(int i = 0; i < count; ++i) {
+            handleSpectrum(spectra + i * length, length);
+        }
+    };
+
+    /* integer magnitudes, the integer statistics are shared the same way */
+    auto handleFixedSpectrum = [this, whistleDetected] (const uint32_t *spectrum, int length) {
+        FixedSpectrumStatistics stats = {0, 0, 0, 0};
+        if(this->config.noiseFloor == NOISE_FLOOR_FRAME) {
+            calcFixedStatistics(spectrum, length, stats);
+        }
+        for(size_t i = 0; i < detectors.size(); ++i) {
+            if(detectors[i].handleFixedBand(spectrum + detectors[i].getBinBegin(), stats)) {
+                whistleDetected(i);
+            }
+        }
+    };
+
+    /* only the bands of all profiles, statistics estimated from them */
+    auto handleBand = [this, whistleDetected, bandBegin] (const float *band, int length, float mean, float dev) {
+        for(size_t i = 0; i < detectors.size(); ++i) {
+            if(detectors[i].handleBand(band + detectors[i].getBinBegin() - bandBegin, mean, dev)) {
+                whistleDetected(i);
+            }
+        }
+    };
+
+    if(config.sEngine == "goertzel") {
+        goertzel = new Goertzel(0, config.nWindowSize, config.nWindowSkipping, config.nWindowSizePadded,
+                                bandBegin, bandEnd, handleBand);
+        newData = std::bind(&Goertzel::newData, goertzel, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+    } else if(config.sEngine == "fixed") {
+        if(config.bStatic || config.bBatched) {
+            std::cerr << "The fixed engine transforms one window at a time (and is not static)." << std::endl;
+        }
+        fixedStft = new FixedSTFT(0, config.nWindowSize, config.nWindowSkipping, config.nWindowSizePadded, handleFixedSpectrum);
+        newData = std::bind(&FixedSTFT::newData, fixedStft, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+    } else if(config.fusion != FUSION_NONE) {
+        /* all channels in one transform call, the detector gets the fused spectrum */
+        if(config.bStatic || config.bBatched) {
+            std::cerr << "Channel fusion batches the channels of a window, not the windows (and is not static)." << std::endl;
+        }
+        multiStft = new MultiChannelSTFT(config.capture.channels, config.nWindowSize, config.nWindowSkipping, config.nWindowSizePadded,
+                                         config.fusion, config.vFusionDelays, handleSpectrum);
+        newData = std::bind(&MultiChannelSTFT::newData, multiStft, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+    } else if(config.bStatic && !config.bBatched && !spectrogram && !publisher
+              && (staticStft = createStaticSTFT(0, config.nWindowSize, config.nWindowSkipping, config.nWindowSizePadded, handleSpectrum))) {
+        /* the spectrum handler is called directly */
+    } else {
+        if(config.bStatic) {
+            std::cerr << "No static transform for this window (or batched, or writing or publishing spectra), using the generic one." << std::endl;
+        }
+        /* every window of a buffer fits into one batch */
+        const int maxBatch = config.capture.periodSize / config.nWindowSkipping + 1;
+        if(config.bBatched) {
+            stft = new STFT(0, config.nWindowSize, config.nWindowSkipping, config.nWindowSizePadded, maxBatch, handleSpectra);
+        } else {
+            stft = new STFT(0, config.nWindowSize, config.nWindowSkipping, config.nWindowSizePadded, handleSpectrum);
+        }
+        newData = std::bind(&STFT::newData, stft, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+    }
+
+    if(spectrogram) {
+        /* one file per run, only as long as the windows stay the same */
+        const SpectrogramHeader &header = spectrogram->getHeader();
+        if(!stft && !multiStft) {
+            std::cerr << "The " << config.sEngine << " engine has no float spectrum, no spectrogram is written!" << std::endl;
+        } else if(static_cast<int>(header.paddedSize) != config.nWindowSizePadded || static_cast<int>(header.hop) != config.nWindowSkipping
+                  || static_cast<int>(header.windowSize) != config.nWindowSize) {
+            std::cerr << "The window changed, no more spectra are written to " << config.sSpectrogramFile << "!" << std::endl;
+        } else if(multiStft) {
+            multiStft->addSpectrumTap(std::bind(&SpectrogramWriter::write, spectrogram, std::placeholders::_1, std::placeholders::_2));
+        } else {
+            stft->addSpectrumTap(std::bind(&SpectrogramWriter::write, spectrogram, std::placeholders::_1, std::placeholders::_2));
+        }
+    }
+
+    if(recorder && recorder->hasSpectra()) {
+        /* the ring is sized for the windows it was started with */
+        if(!recorder->matchesSpectra(config.nWindowSize, config.nWindowSizePadded, config.nWindowSkipping)) {
+            std::cerr << "The window changed, the recorder keeps no more spectra!" << std::endl;
+        } else if(multiStft) {
+            multiStft->addSpectrumTap(std::bind(&PreTriggerRecorder::writeSpectrum, recorder, std::placeholders::_1, std::placeholders::_2));
+        } else if(stft) {
+            stft->addSpectrumTap(std::bind(&PreTriggerRecorder::writeSpectrum, recorder, std::placeholders::_1, std::placeholders::_2));
+        } else {
+            std::cerr << "The recorder only keeps the spectra of the fft engine (not static)!" << std::endl;
+        }
+    }
+
+    if(publisher) {
+        /* readers size their buffers by the header, it stays as it was opened */
+        if(!stft && !multiStft) {
+            std::cerr << "The " << config.sEngine << " engine has no float spectrum, nothing is published!" << std::endl;
+        } else if(!publisher->matches(config.nWindowSize, config.nWindowSizePadded, config.nWindowSkipping)) {
+            std::cerr << "The window changed, no more spectra are published to " << config.sPublishName << "!" << std::endl;
+        } else if(multiStft) {
+            multiStft->addSpectrumTap(std::bind(&SpectrumPublisher::publish, publisher, std::placeholders::_1, std::placeholders::_2));
+            spectrumPublisher = publisher;
+        } else {
+            stft->addSpectrumTap(std::bind(&SpectrumPublisher::publish, publisher, std::placeholders::_1, std::placeholders::_2));
+            spectrumPublisher = publisher;
+        }
+    }
+
+    if(config.bGate) {
+        if(spectrogram) {
+            std::cerr << "The spectrogram needs every frame, the gate is off!" << std::endl;
+        } else {
+            gate = new EnergyGate(config.fSampleRate, fBandBegin, fBandEnd, config.vGateThreshold,
+                                  config.nGateHold, config.nGateAdaptation);
+        }
+    }
+}
+
+Pipeline::~Pipeline()
+{
+    delete stft;
+    delete multiStft;
+    delete fixedStft;
+    delete goertzel;
+    delete staticStft;
+    delete gate;
+}
+
+void Pipeline::process(const int16_t *data, int length, short channels)
+{
+    if(spectrumPublisher) {
+        /* the spectra of a buffer share the capture time of its last sample */
+        spectrumPublisher->setTimestamp(Timing::captureTime((nextFrame + length) * config.nDecimation));
+    }
+    if(gate) {
+        const bool wasOpen = gate->isOpen();
+        if(!gate->update(data, length, channels)) {
+            if(spectrumPublisher) {
+                spectrumPublisher->markGap();
+            }
+            nextFrame += length;
+            return;
+        }
+        if(!wasOpen) {
+            /* the windows start again with the pre-roll, so the onset of a whistle is not lost */
+            restart();
+            const int frames = std::min(config.nGatePreRoll, historyFill);
+            firstFrame = nextFrame - frames;
+            firstWindow = detectors[0].getFrames();
+            if(frames) {
+                transform(&history[history.size() - static_cast<size_t>(frames) * channels], frames, channels);
+            }
+        }
+    }
+    transform(data, length, channels);
+    nextFrame += length;
+}
+
+void Pipeline::restart()
+{
+    if(stft) {
+        stft->restart();
+    }
+    if(multiStft) {
+        multiStft->restart();
+    }
+    if(fixedStft) {
+        fixedStft->restart();
+    }
+    if(goertzel) {
+        goertzel->restart();
+    }
+    if(staticStft) {
+        staticStft->restart();
+    }
+}
 
-        float mean, dev;
-        calcMeanDeviation(spectrum, length, mean, dev);
+void Pipeline::startOver()
+{
+    restart();
+    if(spectrumPublisher) {
+        spectrumPublisher->markGap();
+    }
+    historyFill = 0;
+    for(size_t i = 0; i < detectors.size(); ++i) {
+        detectors[i].reset();
+    }
+    firstFrame = nextFrame;
+    firstWindow = detectors[0].getFrames();
+}
 
-        bool found;
-        const float whistleThresh = mean + config.vWhistleThreshold * dev;
-        found = false;
+void Pipeline::remember(const int16_t *data, int length, short channels)
+{
+    if(history.size() != static_cast<size_t>(historyFrames) * channels) {
+        /* a recording with another channel count than configured, happens once */
+        history.assign(static_cast<size_t>(historyFrames) * channels, 0);
+        historyFill = 0;
+    }
+    const int frames = std::min(length, historyFrames);
+    const size_t keep = static_cast<size_t>(historyFrames - frames) * channels;
+    memmove(&history[0], &history[history.size() - keep], keep * sizeof(int16_t));
+    memcpy(&history[keep], data + static_cast<size_t>(length - frames) * channels, static_cast<size_t>(frames) * channels * sizeof(int16_t));
+    historyFill = std::min(historyFrames, historyFill + length);
+}
 
-        int i;
-        for(i = config.nWhistleBegin; i < config.nWhistleEnd; ++i) {
-            if(spectrum[i] > whistleThresh) {
-                found = true;
-                break;
+void Pipeline::takeOver(const Pipeline &previous, uint64_t frame, short channels)
+{
+    /* the samples the previous pipeline kept for its next window, not transformed (the windows before
+     * were judged already), so the new windows continue its grid and none is lost or counted twice */
+    const int frames = std::min(std::min(previous.pendingFrames(frame), config.nWindowSize - 1), previous.historyFill);
+    const int16_t *tail = &previous.history[previous.history.size() - static_cast<size_t>(frames) * channels];
+    firstFrame = frame - frames;
+    firstWindow = detectors[0].getFrames();
+    /* a whistle heard by the previous pipeline is not reported again, profiles are matched by name */
+    detectors[0].continueFrom(previous.detectors[0]);
+    for(size_t i = 0; i < config.profiles.size(); ++i) {
+        for(size_t k = 0; k < previous.config.profiles.size(); ++k) {
+            if(previous.config.profiles[k].name == config.profiles[i].name) {
+                detectors[i + 1].continueFrom(previous.detectors[k + 1]);
             }
         }
+    }
+    if(gate && previous.gate) {
+        gate->continueFrom(*previous.gate);
+    }
+    if(frames) {
+        transform(tail, frames, channels);
+    }
+    /* the gate pre-roll reaches further back than the window */
+    const int kept = std::min(historyFrames, previous.historyFill);
+    if(kept) {
+        remember(&previous.history[previous.history.size() - static_cast<size_t>(kept) * channels], kept, channels);
+    }
+    nextFrame = frame;
+}
+
+int Pipeline::pendingFrames(uint64_t frame) const
+{
+    const int window = config.nWindowSize, hop = config.nWindowSkipping;
+    if(gate && !gate->isOpen()) {
+        /* no windows while closed, a new pipeline without gate starts right after the last one */
+        return std::max(window - hop, 0);
+    }
+    const uint64_t elapsed = frame - firstFrame;
+    if(elapsed < static_cast<uint64_t>(window)) {
+        return static_cast<int>(elapsed);
+    }
+    const uint64_t next = ((elapsed - window) / hop + 1) * hop;
+    return elapsed > next ? static_cast<int>(elapsed - next) : 0;
+}
+
+#define DECIMATION_BLOCK    (4096)  /* captured frames decimated at once */
+
+PipelineSwitch::PipelineSwitch(Pipeline *pipeline, const ProcessingRecord &config, PreTriggerRecorder *recorder)
+    : pipeline(pipeline), processedFrames(0), recorder(recorder), decimator(NULL)
+{
+    if(config.nDecimation > 1) {
+        decimator = new Decimator(config.nDecimation, config.capture.channels);
+        decimated.resize(static_cast<size_t>(DECIMATION_BLOCK / config.nDecimation + 1) * config.capture.channels);
+    }
+}
 
-        if(whistleDone) {
-            if(!found) {
-                ++whistleMissCounter;
-                if(whistleMissCounter > config.nWhistleMissFrames) {
-                    whistleCounter = 0;
-                    whistleMissCounter = 0;
-                    whistleDone = false;
-                }
+PipelineSwitch::~PipelineSwitch()
+{
+    delete decimator;
+}
+
+void PipelineSwitch::newData(const int16_t *data, int length, short channels)
+{
+    if(recorder) {
+        recorder->write(data, length, channels);
+    }
+    if(!decimator) {
+        process(data, length, channels);
+        return;
+    }
+    if(decimator->getChannels() != channels) {
+        /* a recording with another channel count than configured, happens once */
+        const int factor = decimator->getFactor();
+        delete decimator;
+        decimator = new Decimator(factor, channels);
+        decimated.resize(static_cast<size_t>(DECIMATION_BLOCK / factor + 1) * channels);
+    }
+    for(int i = 0; i < length; i += DECIMATION_BLOCK) {
+        const int n = std::min(length - i, DECIMATION_BLOCK);
+        const int frames = decimator->process(data + i * channels, n, &decimated[0]);
+        if(frames > 0) {
+            process(&decimated[0], frames, channels);
+        }
+    }
+}
+
+void PipelineSwitch::restart()
+{
+    if(decimator) {
+        decimator->reset();
+    }
+    pipeline->startOver();
+}
+
+void PipelineSwitch::process(const int16_t *data, int length, short channels)
+{
+    Pipeline *next = pendingPipeline.load();
+    if(next) {
+        next->takeOver(*pipeline, processedFrames, channels);
+        activePipeline.store(next);
+        pendingPipeline.store(NULL);
+        pipeline = next;
+    }
+    pipeline->process(data, length, channels);
+    pipeline->remember(data, length, channels);
+    processedFrames += length;
+}
+
+int executeAction(const ProcessingRecord &config, const WhistleHandler &whistleAction)
+{
+    if(!config.sInputFile.empty() && SpectrogramReader::isSpectrogram(config.sInputFile)) {
+        return replaySpectrogram(config, whistleAction);
+    }
+
+    /* the audio thread only queues the events then */
+    EventDispatcher *dispatcher = NULL;
+    WhistleHandler action = whistleAction;
+    if(config.bAsyncEvents) {
+        dispatcher = new EventDispatcher(whistleAction, config.nEventQueue, static_cast<uint64_t>(config.fEventCoalesce * 1e9));
+        if(dispatcher->start()) {
+            action = std::bind(&EventDispatcher::post, dispatcher, std::placeholders::_1);
+        }
+    }
+
+    /* every detection queues a dump of the audio around it, written by the recorder's thread */
+    if(config.bRecorder) {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        dumpRecorder = new PreTriggerRecorder(config.sRecorderDirectory, config.capture.sampleRate, config.capture.channels,
+                                              config.fRecorderSeconds, config.fRecorderBefore, config.fRecorderAfter);
+        if(config.bRecorderSpectra) {
+            dumpRecorder->keepSpectra(config.fSampleRate, config.nWindowSize, config.nWindowSizePadded, config.nWindowSkipping);
+        }
+        if(dumpRecorder->start()) {
+            PreTriggerRecorder *dumps = dumpRecorder;
+            const WhistleHandler next = action;
+            action = [dumps, next] (const WhistleEvent &event) {
+                dumps->trigger(event);
+                next(event);
+            };
+        } else {
+            delete dumpRecorder;
+            dumpRecorder = NULL;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        if(!config.sSpectrogramFile.empty()) {
+            spectrogram = new SpectrogramWriter(config.sSpectrogramFile,
+                                                config.sSpectrogramFormat == "float16" ? SPECTROGRAM_FLOAT16 : SPECTROGRAM_FLOAT32,
+                                                config.fSampleRate, config.nWindowSize, config.nWindowSizePadded,
+                                                config.nWindowSkipping, config.nSpectrogramBegin, config.nSpectrogramEnd);
+            if(!spectrogram->open()) {
+                delete spectrogram;
+                spectrogram = NULL;
             }
         }
-        else
-        {
-            if(found) {
-                ++whistleCounter;
-                whistleMissCounter = 0;
-            } else if(whistleCounter > 0) {
-                ++whistleMissCounter;
-                if(whistleMissCounter > config.nWhistleMissFrames) {
-                    whistleCounter = 0;
-                    whistleMissCounter = 0;
-                    whistleDone = false;
-                }
+        if(config.bPublish) {
+            publisher = new SpectrumPublisher(config.sPublishName, config.fSampleRate, config.nWindowSize,
+                                              config.nWindowSizePadded, config.nWindowSkipping, config.nPublishSlots);
+            if(!publisher->open()) {
+                delete publisher;
+                publisher = NULL;
             }
-            if(whistleCounter >= config.nWhistleOkayFrames) {
-                whistleAction();
-                whistleCounter = 0;
-                whistleMissCounter = 0;
-                whistleDone = true;
+            /* the spectra are stamped with the capture time */
+            Timing::setAnchoring(publisher != NULL);
+        }
+
+        activeConfig = config;
+        activeAction = action;
+        pipelines.push_back(new Pipeline(config, action, spectrogram, dumpRecorder, publisher));
+        activePipeline.store(pipelines.back());
+    }
+
+    PipelineSwitch pipelineSwitch(activePipeline.load(), config, dumpRecorder);
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        if(config.sInputFile.empty()) {
+            if(config.capture.mmap && config.capture.ringFrames > 0) {
+                /* the DSP thread reads after the DMA area was handed back, so the period goes into the ring */
+                std::cout << "Note: with the ring buffer the mmap capture still copies every period into the ring." << std::endl;
             }
+            reader = new SinkSource<AlsaRecorder, PipelineSwitch>(pipelineSwitch, config.capture);
+        } else {
+            reader = new SinkSource<FileSource, PipelineSwitch>(pipelineSwitch, config.sInputFile, config.capture.periodSize,
+                                                                config.capture.channels, config.capture.sampleRate);
         }
-    };
+    }
 
-    STFT stft(0, config.nWindowSize, config.nWindowSkipping, config.nWindowSizePadded, handleSpectrum);
-    reader = new AlsaRecorder(std::bind(&STFT::newData, &stft, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    ConfigWatcher *watcher = NULL;
+    if(config.bWatchConfig && !configPath.empty()) {
+        watcher = new ConfigWatcher(configPath, [] () { reloadConfig(); });
+        watcher->start();
+    }
 
     std::cout << "Listening ..." << std::endl;
     reader->main();
     std::cout << "... stopped listening." << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        const Pipeline *pipeline = activePipeline.load();
+        if(pipeline && pipeline->gate && pipeline->gate->getBuffers()) {
+            std::cout << "Gate open for " << pipeline->gate->getOpenBuffers() << " of " << pipeline->gate->getBuffers() << " buffers ("
+                      << 100 * pipeline->gate->getOpenBuffers() / pipeline->gate->getBuffers() << " %)." << std::endl;
+        }
+    }
+    if(Timing::isEnabled()) {
+        std::cout << Timing::report();
+    }
+
+    delete watcher;
+
+    if(dumpRecorder) {
+        /* pending dumps are written with the audio there is */
+        dumpRecorder->stop();
+        if(dumpRecorder->getDropped()) {
+            std::cerr << dumpRecorder->getDropped() << " dumps dropped, the writer was too slow!" << std::endl;
+        }
+    }
+
+    if(dispatcher) {
+        /* the events still queued go out before returning */
+        dispatcher->stop();
+        if(dispatcher->getDropped()) {
+            std::cerr << dispatcher->getDropped() << " whistle events dropped, the handler was too slow!" << std::endl;
+        }
+        delete dispatcher;
+        dispatcher = NULL;
+    }
+
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    if(spectrogram) {
+        spectrogram->close();
+        std::cout << spectrogram->getFrames() << " spectra written to " << config.sSpectrogramFile << "." << std::endl;
+    }
+
+    for(size_t i = 0; i < pipelines.size(); ++i) {
+        delete pipelines[i];
+    }
+    pipelines.clear();
+    activePipeline.store(NULL);
+    pendingPipeline.store(NULL);
+    activeAction = WhistleHandler();
+    delete spectrogram;
+    spectrogram = NULL;
+    delete dumpRecorder;
+    dumpRecorder = NULL;
+    if(publisher) {
+        std::cout << publisher->getPublished() << " spectra published to " << config.sPublishName << "." << std::endl;
+    }
+    delete publisher;
+    publisher = NULL;
+    Timing::setAnchoring(false);
+    return 0;
+}
+
+bool reloadConfig()
+{
+    std::unique_lock<std::mutex> lock(reloadMutex);
+    if(!activeAction || !reader || !reader->isRunning()) {
+        std::cerr << "Not listening, nothing to reload!" << std::endl;
+        return false;
+    }
+    if(pendingPipeline.load()) {
+        std::cerr << "The previous configuration is not applied yet (paused?), try again later!" << std::endl;
+        return false;
+    }
+
+    /* everything the audio thread does not use any more */
+    Pipeline *active = activePipeline.load();
+    for(size_t i = 0; i < pipelines.size(); ) {
+        if(pipelines[i] != active) {
+            delete pipelines[i];
+            pipelines.erase(pipelines.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+
+    ProcessingRecord config;
+    try {
+        readConfig(configPath, config);
+    } catch(const boost::property_tree::ptree_error &e) {
+        std::cerr << "cannot reload " << configPath << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    /* the capture keeps running as it is */
+    config.sInputFile = activeConfig.sInputFile;
+    if(config.fSampleRate != activeConfig.fSampleRate) {
+        std::cerr << "The sample rate cannot change while listening!" << std::endl;
+        return false;
+    }
+    const CaptureConfig &capture = activeConfig.capture;
+    if(config.capture.device != capture.device || config.capture.channels != capture.channels
+       || config.capture.periodSize != capture.periodSize || config.capture.periods != capture.periods
+       || config.capture.ringFrames != capture.ringFrames || config.capture.mmap != capture.mmap) {
+        std::cerr << "Capture settings only change on restart, keeping the running ones." << std::endl;
+    }
+    config.capture = capture;
+    if(config.sSpectrogramFile != activeConfig.sSpectrogramFile) {
+        std::cerr << "The spectrogram file only changes on restart." << std::endl;
+    }
+    if(config.bAsyncEvents != activeConfig.bAsyncEvents || config.nEventQueue != activeConfig.nEventQueue
+       || config.fEventCoalesce != activeConfig.fEventCoalesce) {
+        std::cerr << "Event settings only change on restart, keeping the running ones." << std::endl;
+    }
+    config.bAsyncEvents = activeConfig.bAsyncEvents;
+    config.nEventQueue = activeConfig.nEventQueue;
+    config.fEventCoalesce = activeConfig.fEventCoalesce;
+    if(config.bRecorder != activeConfig.bRecorder || config.sRecorderDirectory != activeConfig.sRecorderDirectory
+       || config.fRecorderSeconds != activeConfig.fRecorderSeconds || config.fRecorderBefore != activeConfig.fRecorderBefore
+       || config.fRecorderAfter != activeConfig.fRecorderAfter || config.bRecorderSpectra != activeConfig.bRecorderSpectra) {
+        std::cerr << "Recorder settings only change on restart, keeping the running ones." << std::endl;
+    }
+    config.bRecorder = activeConfig.bRecorder;
+    config.sRecorderDirectory = activeConfig.sRecorderDirectory;
+    config.fRecorderSeconds = activeConfig.fRecorderSeconds;
+    config.fRecorderBefore = activeConfig.fRecorderBefore;
+    config.fRecorderAfter = activeConfig.fRecorderAfter;
+    config.bRecorderSpectra = activeConfig.bRecorderSpectra;
+    if(config.bPublish != activeConfig.bPublish || config.sPublishName != activeConfig.sPublishName
+       || config.nPublishSlots != activeConfig.nPublishSlots) {
+        std::cerr << "Publish settings only change on restart, keeping the running ones." << std::endl;
+    }
+    config.bPublish = activeConfig.bPublish;
+    config.sPublishName = activeConfig.sPublishName;
+    config.nPublishSlots = activeConfig.nPublishSlots;
+
+    if(prepareExtraction(config) != 0) {
+        return false;
+    }
+
+    /* plans and buffers are built here, the audio thread only swaps the pointer */
+    Pipeline *next = new Pipeline(config, activeAction, spectrogram, dumpRecorder, publisher);
+    pipelines.push_back(next);
+    pendingPipeline.store(next);
+    activeConfig = config;
+
+    /* the other module methods are not blocked while the audio thread switches */
+    AudioSource *source = reader;
+    lock.unlock();
+    for(int i = 0; i < RELOAD_TIMEOUT_MS && pendingPipeline.load() && source->isRunning(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if(pendingPipeline.load()) {
+        std::cout << "Configuration reloaded, applied as soon as listening continues." << std::endl;
+    } else {
+        std::cout << "Configuration reloaded." << std::endl;
+    }
+    return true;
+}
+
+bool dumpRecording()
+{
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    if(!dumpRecorder) {
+        std::cerr << "The recorder is off, nothing to dump!" << std::endl;
+        return false;
+    }
+    dumpRecorder->triggerNow();
+    return true;
+}
+
+int replaySpectrogram(const ProcessingRecord &config, const WhistleHandler &whistleAction)
+{
+    SpectrogramReader spectrogram(config.sInputFile);
+    if(!spectrogram.open()) {
+        return -1;
+    }
+
+    /* the detector needs the same transform and the whole band */
+    const SpectrogramHeader &header = spectrogram.getHeader();
+    if(static_cast<int>(header.windowSize) != config.nWindowSize || static_cast<int>(header.paddedSize) != config.nWindowSizePadded
+       || static_cast<int>(header.hop) != config.nWindowSkipping || static_cast<int>(header.sampleRate) != config.fSampleRate) {
+        std::cerr << "Spectrogram " << config.sInputFile << " was computed with another window, hop or sample rate!" << std::endl;
+        return -1;
+    }
+    if(config.nWhistleBegin < static_cast<int>(header.binBegin) || config.nWhistleEnd > static_cast<int>(header.binEnd)) {
+        std::cerr << "Spectrogram " << config.sInputFile << " does not contain the whistle band!" << std::endl;
+        return -1;
+    }
+
+    std::vector<Detector> detectors;
+    std::vector<std::string> names;
+    detectors.reserve(config.profiles.size() + 1);
+    detectors.emplace_back(config.nWhistleBegin, config.nWhistleEnd, config.vWhistleThreshold,
+                           config.nWhistleOkayFrames, config.nWhistleMissFrames);
+    names.push_back(std::string());
+    for(size_t i = 0; i < config.profiles.size(); ++i) {
+        const WhistleProfile &profile = config.profiles[i];
+        if(profile.nWhistleBegin < static_cast<int>(header.binBegin) || profile.nWhistleEnd > static_cast<int>(header.binEnd)) {
+            std::cerr << "Spectrogram " << config.sInputFile << " does not contain the band of profile " << profile.name << ", skipped!" << std::endl;
+            continue;
+        }
+        detectors.emplace_back(profile.nWhistleBegin, profile.nWhistleEnd, profile.vWhistleThreshold,
+                               profile.nWhistleOkayFrames, profile.nWhistleMissFrames);
+        names.push_back(profile.name);
+    }
+    for(size_t i = 0; i < detectors.size(); ++i) {
+        detectors[i].setNoiseFloor(config.noiseFloor, config.nNoiseFrames, config.vNoisePercentile);
+    }
+
+    std::cout << "Listening ..." << std::endl;
+    const uint64_t begin = Timing::now();
+    spectrogram.replay([&] (const float *band, int length, float mean, float dev) {
+        for(size_t i = 0; i < detectors.size(); ++i) {
+            const Detector &detector = detectors[i];
+            if(!detectors[i].handleBand(band + detector.getBinBegin() - static_cast<int>(header.binBegin), mean, dev)) {
+                continue;
+            }
+            /* as live: the onset window is complete with its last sample */
+            const uint64_t onsetFrame = detector.getOnsetFrame() * header.hop + header.windowSize;
+            std::cout << "Whistle " << (names[i].empty() ? "" : names[i] + " ") << "onset at "
+                      << static_cast<double>(onsetFrame) / header.sampleRate << " s" << std::endl;
+            WhistleEvent event;
+            event.detected   = Timing::now();
+            event.onset      = 0;
+            event.position   = onsetFrame * 1000000000ull / header.sampleRate;
+            event.confidence = detector.getConfidence();
+            event.count      = 1;
+            strncpy(event.profile, names[i].c_str(), sizeof(event.profile) - 1);
+            event.profile[sizeof(event.profile) - 1] = '\0';
+            StageTimer timer(TIMING_ACTION);
+            whistleAction(event);
+        }
+    });
+    const double elapsed = (Timing::now() - begin) / 1e9;
+    std::cout << "... stopped listening." << std::endl;
+
+    std::cout << spectrogram.getFrames() << " spectra in " << elapsed << " s";
+    if(elapsed > 0) {
+        std::cout << ", " << (spectrogram.getFrames() / elapsed) << " spectra/s";
+    }
+    std::cout << "." << std::endl;
+    return 0;
+}
+
+int executeStreams(const ProcessingRecord &config, const std::vector<std::string> &inputFiles, int threads)
+{
+    /* the bank judges every frame against the statistics of its own spectrum */
+    if(config.noiseFloor != NOISE_FLOOR_FRAME) {
+        std::cerr << "Batch processing only supports NoiseFloor = frame, not " << noiseFloorName(config.noiseFloor) << "!" << std::endl;
+        return -1;
+    }
+    /* the bank is the plain detector of [Whistle], say what it leaves out */
+    for(size_t i = 0; i < config.profiles.size(); ++i) {
+        std::cerr << "Warning: batch processing ignores the profile " << config.profiles[i].name << "." << std::endl;
+    }
+    if(config.sEngine != "fft" || config.bStatic) {
+        std::cerr << "Warning: batch processing always runs the batched fft engine, not " << config.sEngine
+                  << (config.bStatic ? " (static)" : "") << "." << std::endl;
+    }
+    if(config.fusion != FUSION_NONE) {
+        std::cerr << "Warning: batch processing analyses channel 0 only, Fusion = " << fusionName(config.fusion) << " is ignored." << std::endl;
+    }
+    if(config.bGate) {
+        std::cerr << "Warning: batch processing transforms every window, the gate is ignored." << std::endl;
+    }
+
+    /* offline, measure the plans before starting instead of one planner thread per stream */
+    setPlanning(config.sWisdomFile, false);
+
+    StreamEngine engine(config.nWindowSize, config.nWindowSkipping, config.nWindowSizePadded,
+                        config.nWhistleBegin, config.nWhistleEnd, config.vWhistleThreshold,
+                        config.nWhistleOkayFrames, config.nWhistleMissFrames, threads);
+
+    std::vector<FileSource*> files;
+    /* recordings at a multiple of the processing rate (captures, pre-trigger dumps) are decimated
+     * like the live input, the engine reads them from here */
+    std::vector<std::vector<int16_t> > decimated(inputFiles.size());
+    long totalFrames = 0;
+    for(size_t i = 0; i < inputFiles.size(); ++i) {
+        FileSource *file = new FileSource(AudioSource::Handler(), inputFiles[i], config.capture.periodSize,
+                                          config.capture.channels, config.capture.sampleRate);
+        if(!file->openFile()) {
+            delete file;
+            continue;
+        }
+        const int sampleRate = file->getSampleRate();
+        long frames = file->getFrames();
+        if(sampleRate == config.fSampleRate) {
+            engine.addStream(file->getSamples(), frames, file->getChannels());
+        } else if(sampleRate > config.fSampleRate && sampleRate % config.fSampleRate == 0) {
+            const int factor = sampleRate / config.fSampleRate;
+            Decimator decimator(factor, file->getChannels());
+            decimated[i].resize(static_cast<size_t>(frames / factor + 1) * file->getChannels());
+            frames = decimator.process(file->getSamples(), static_cast<int>(frames), &decimated[i][0]);
+            engine.addStream(&decimated[i][0], frames, file->getChannels());
+        } else {
+            std::cerr << file->getPath() << " is sampled at " << sampleRate << " Hz, no multiple of the "
+                      << config.fSampleRate << " Hz processed, skipped!" << std::endl;
+            delete file;
+            continue;
+        }
+        totalFrames += frames;
+        files.push_back(file);
+    }
+    if(files.empty()) {
+        std::cerr << "No recording to process!" << std::endl;
+        return -1;
+    }
 
+    std::cout << "Processing " << files.size() << " recording(s) with " << engine.getThreads() << " thread(s) ..." << std::endl;
+    const uint64_t begin = Timing::now();
+    engine.run();
+    const double elapsed = (Timing::now() - begin) / 1e9;
+
+    for(size_t i = 0; i < files.size(); ++i) {
+        const std::vector<uint64_t> &detections = engine.getDetections(static_cast<int>(i));
+        std::cout << files[i]->getPath() << ": " << detections.size() << " whistle(s)";
+        for(size_t k = 0; k < detections.size(); ++k) {
+            std::cout << (k ? ", " : " at ") << static_cast<double>(detections[k]) / config.fSampleRate << " s";
+        }
+        std::cout << std::endl;
+        delete files[i];
+    }
+
+    std::cout << totalFrames << " frames in " << elapsed << " s";
+    if(elapsed > 0) {
+        std::cout << ", " << (totalFrames / elapsed) << " frames/s, "
+                  << (totalFrames / elapsed / config.fSampleRate) << "x real time";
+    }
+    std::cout << "." << std::endl;
     return 0;
 }
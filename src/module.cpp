@@ -1,5 +1,6 @@
 // Whistel detection module for NaoQi
 
+#include <set>
 #include <boost/shared_ptr.hpp>
 
 #include <alcommon/albroker.h>
@@ -7,11 +8,18 @@
 #include <alcommon/altoolsmain.h>
 #include <alproxies/almemoryproxy.h>
 
+#include "EventDispatcher.h"
+
 #define ALCALL
 
-extern int main_loop(const std::string& configFile, void (*whistleAction)(void));
+extern int main_events(const std::string& configFile, const std::string& inputFile, const WhistleHandler &whistleAction);
 extern void stopListening(int signal);
 extern void setListeningPaused(bool paused);
+extern std::string getCaptureStatistics();
+extern std::string getTimingReport();
+extern void resetTiming();
+extern bool reloadConfig();
+extern bool dumpRecording();
 
 
 class WhistelDetector: public AL::ALModule {
@@ -22,6 +30,25 @@ public:
         functionName("setPaused", getName(), "pause / unpause whistel detection");
         addParam("paused", "bool for paused");
         BIND_METHOD(WhistelDetector::setPaused);
+
+        functionName("getCaptureStatistics", getName(), "fill level and overruns of the capture ring buffer, last resume latency");
+        setReturn("statistics", "human readable statistics");
+        BIND_METHOD(WhistelDetector::getCaptureStatistics);
+
+        functionName("getTimingReport", getName(), "per stage processing times and detection latency");
+        setReturn("report", "table of count, mean and percentiles in microseconds");
+        BIND_METHOD(WhistelDetector::getTimingReport);
+
+        functionName("resetTiming", getName(), "clear the timing statistics");
+        BIND_METHOD(WhistelDetector::resetTiming);
+
+        functionName("reloadConfig", getName(), "apply a changed WhistleConfig.ini without stopping the capture");
+        setReturn("success", "false if the config is invalid, the running one is kept then");
+        BIND_METHOD(WhistelDetector::reloadConfig);
+
+        functionName("dumpRecording", getName(), "write the last seconds of audio of the recorder to a file");
+        setReturn("success", "false if the recorder is off");
+        BIND_METHOD(WhistelDetector::dumpRecording);
     }
 
     virtual ~WhistelDetector() {
@@ -33,6 +60,7 @@ public:
             mSelf = this;
         }
         mMemoryProxy.declareEvent("WhistleHeard");
+        mDeclaredEvents.insert("WhistleHeard");
         mThread = boost::thread(&WhistelDetector::main, this);
         pthread_setname_np(mThread.native_handle(), "WhistleDetector");
     }
@@ -46,23 +74,57 @@ public:
         setListeningPaused(paused);
     }
 
+    std::string getCaptureStatistics() {
+        return ::getCaptureStatistics();
+    }
+
+    std::string getTimingReport() {
+        return ::getTimingReport();
+    }
+
+    void resetTiming() {
+        ::resetTiming();
+    }
+
+    bool reloadConfig() {
+        return ::reloadConfig();
+    }
+
+    bool dumpRecording() {
+        return ::dumpRecording();
+    }
+
 private:
     int main() {
-        return main_loop("/home/nao/WhistleConfig.ini", &WhistelDetector::whistleActionWrapper);
+        return main_events("/home/nao/WhistleConfig.ini", std::string(), &WhistelDetector::whistleActionWrapper);
     }
 
-    static void whistleActionWrapper() {
-        mSelf->whistleAction();
+    static void whistleActionWrapper(const WhistleEvent &event) {
+        mSelf->whistleAction(event);
     }
 
-    void whistleAction() {
+    /* WhistleHeard or WhistleHeard/<profile> for [Whistle.<profile>],
+     * [count, detection time, onset time (0: unknown), confidence], times in s of CLOCK_MONOTONIC */
+    void whistleAction(const WhistleEvent &event) {
+        const std::string name = event.profile[0] ? std::string("WhistleHeard/") + event.profile : std::string("WhistleHeard");
+        if(mDeclaredEvents.insert(name).second) {
+            /* profiles may be added by a reload */
+            mMemoryProxy.declareEvent(name);
+        }
         mWhistelCount++;
-        mMemoryProxy.raiseEvent("WhistleHeard", mWhistelCount);
+        AL::ALValue value;
+        value.arraySetSize(4);
+        value[0] = mWhistelCount;
+        value[1] = event.detected / 1e9;
+        value[2] = event.onset / 1e9;
+        value[3] = event.confidence;
+        mMemoryProxy.raiseEvent(name, value);
     }
 
 private:
     static WhistelDetector* mSelf;
     int mWhistelCount;
+    std::set<std::string> mDeclaredEvents;
     boost::thread mThread;
     AL::ALMemoryProxy mMemoryProxy;
 };
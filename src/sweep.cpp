@@ -0,0 +1,192 @@
+// offline evaluation of whistle detector parameters on labeled recordings
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+
+#include "Planner.h"
+#include "SoundConfig.h"
+#include "SweepEvaluator.h"
+
+/* comma separated values, an entry begin:step:end expands to a range */
+template<typename T>
+static std::vector<T> parseList(const std::string &text)
+{
+    std::vector<T> values;
+    std::istringstream items(text);
+    std::string item;
+    while(std::getline(items, item, ',')) {
+        double begin, step, end;
+        if(sscanf(item.c_str(), "%lf:%lf:%lf", &begin, &step, &end) == 3 && step > 0.0) {
+            for(double v = begin; v <= end + step * 1e-6; v += step) {
+                values.push_back(static_cast<T>(v));
+            }
+        } else if(item.find_first_not_of(" \t") != std::string::npos) {
+            values.push_back(static_cast<T>(atof(item.c_str())));
+        }
+    }
+    return values;
+}
+
+/* the sweep value if given, otherwise the one of the detector configuration */
+template<typename T>
+static std::vector<T> sweepValues(const boost::property_tree::ptree &sweep, const boost::property_tree::ptree &base,
+                                  const std::string &key, const std::string &baseKey)
+{
+    return parseList<T>(sweep.get<std::string>("Sweep." + key, base.get<std::string>(baseKey)));
+}
+
+/* lines of path[,begin,end] with the whistle times in s, # starts a comment */
+static bool readLabels(const std::string &labelFile, std::vector<std::string> &paths,
+                       std::vector<std::vector<std::pair<double, double> > > &whistles)
+{
+    std::ifstream in(labelFile.c_str());
+    if(!in) {
+        std::cerr << "cannot open label file " << labelFile << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(in, line)) {
+        if(line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string path, begin, end;
+        std::getline(fields, path, ',');
+        std::getline(fields, begin, ',');
+        std::getline(fields, end, ',');
+
+        size_t index = std::find(paths.begin(), paths.end(), path) - paths.begin();
+        if(index == paths.size()) {
+            paths.push_back(path);
+            whistles.push_back(std::vector<std::pair<double, double> >());
+        }
+        if(!begin.empty() && !end.empty()) {
+            whistles[index].push_back(std::make_pair(atof(begin.c_str()), atof(end.c_str())));
+        }
+    }
+    return true;
+}
+
+static bool better(const SweepResult &a, const SweepResult &b)
+{
+    if(a.f1() != b.f1()) {
+        return a.f1() > b.f1();
+    }
+    return a.meanLatency() < b.meanLatency();
+}
+
+/* usage: whistle_detector_sweep [-c WhistleConfig.ini] [-s Sweep.ini] [-j threads] [-o results.csv] labels.csv */
+int main(int argc, char **argv)
+{
+    std::string configFile = "WhistleConfig.ini", sweepFile = "Sweep.ini", outputFile, labelFile;
+    int threads = 0;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            configFile = argv[++i];
+        } else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            sweepFile = argv[++i];
+        } else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else {
+            labelFile = argv[i];
+        }
+    }
+    if(labelFile.empty()) {
+        std::cerr << "usage: " << argv[0] << " [-c WhistleConfig.ini] [-s Sweep.ini] [-j threads] [-o results.csv] labels.csv" << std::endl;
+        return 1;
+    }
+
+    boost::property_tree::ptree base, sweep;
+    boost::property_tree::ini_parser::read_ini(configFile, base);
+    boost::property_tree::ini_parser::read_ini(sweepFile, sweep);
+
+    SweepGrid grid;
+    grid.windowSizes    = sweepValues<int>(sweep, base, "WindowSize", "Time.WindowSize");
+    grid.paddedSizes    = sweepValues<int>(sweep, base, "WindowSizePadded", "Time.WindowSizePadded");
+    grid.hops           = sweepValues<int>(sweep, base, "WindowSkipping", "Time.WindowSkipping");
+    grid.whistleBegins  = sweepValues<float>(sweep, base, "WhistleBegin", "Frequencies.WhistleBegin");
+    grid.whistleEnds    = sweepValues<float>(sweep, base, "WhistleEnd", "Frequencies.WhistleEnd");
+    grid.thresholds     = sweepValues<float>(sweep, base, "Threshold", "Whistle.Threshold");
+    grid.okayFrames     = sweepValues<unsigned>(sweep, base, "FrameOkays", "Whistle.FrameOkays");
+    grid.missFrames     = sweepValues<unsigned>(sweep, base, "FrameMisses", "Whistle.FrameMisses");
+    grid.tolerance      = sweep.get<double>("Sweep.Tolerance", 0.5);
+
+    /* the evaluator judges every frame against the statistics of its own spectrum */
+    const std::string noiseFloor = base.get<std::string>("Whistle.NoiseFloor", "frame");
+    if(noiseFloor != "frame") {
+        std::cerr << "The sweep only evaluates NoiseFloor = frame, not " << noiseFloor << "!" << std::endl;
+        return 1;
+    }
+
+    const int sampleRate    = base.get<int>("Frequencies.SampleRate");
+    const short channels    = base.get<short>("Capture.Channels", NUM_CHANNELS_RX);
+
+    const std::string wisdomFile = base.get<std::string>("FFTW.Wisdom", "");
+    setPlanning(wisdomFile, false);
+    if(!wisdomFile.empty()) {
+        importWisdom(wisdomFile);
+    }
+
+    std::vector<std::string> paths;
+    std::vector<std::vector<std::pair<double, double> > > whistles;
+    if(!readLabels(labelFile, paths, whistles)) {
+        return 1;
+    }
+
+    SweepEvaluator evaluator(threads);
+    for(size_t i = 0; i < paths.size(); ++i) {
+        evaluator.addRecording(paths[i], whistles[i], channels, sampleRate);
+    }
+    if(evaluator.getRecordings() == 0) {
+        std::cerr << "No recording to evaluate!" << std::endl;
+        return 1;
+    }
+
+    std::vector<SweepResult> results = evaluator.run(grid);
+    if(results.empty()) {
+        std::cerr << "The grid is empty!" << std::endl;
+        return 1;
+    }
+    std::stable_sort(results.begin(), results.end(), better);
+
+    std::ofstream file;
+    if(!outputFile.empty()) {
+        file.open(outputFile.c_str());
+        if(!file) {
+            std::cerr << "cannot write " << outputFile << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &out = outputFile.empty() ? std::cout : file;
+
+    out << "WindowSize,WindowSizePadded,WindowSkipping,WhistleBegin,WhistleEnd,Threshold,FrameOkays,FrameMisses,"
+        << "Whistles,TruePositives,FalsePositives,Precision,Recall,F1,LatencyMean,LatencyMax" << std::endl;
+    for(size_t i = 0; i < results.size(); ++i) {
+        const SweepResult &r = results[i];
+        out << r.windowSize << "," << r.paddedSize << "," << r.hop << ","
+            << r.whistleBegin << "," << r.whistleEnd << "," << r.threshold << ","
+            << r.okayFrames << "," << r.missFrames << ","
+            << r.whistles << "," << r.truePositives << "," << r.falsePositives << ","
+            << r.precision() << "," << r.recall() << "," << r.f1() << ","
+            << r.meanLatency() << "," << r.latencyMax << std::endl;
+    }
+
+    const SweepResult &best = results.front();
+    std::cout << results.size() << " configurations evaluated, best: window " << best.windowSize << "/"
+              << best.paddedSize << "/" << best.hop << ", " << best.whistleBegin << "-" << best.whistleEnd
+              << " Hz, threshold " << best.threshold << ", " << best.okayFrames << " okays, " << best.missFrames
+              << " misses: precision " << best.precision() << ", recall " << best.recall()
+              << ", latency " << best.meanLatency() << " s." << std::endl;
+    return 0;
+}
@@ -3,17 +3,27 @@
 #include <iostream>
 #include <csignal>
 
-extern int main_loop(const std::string& configFile, void (*whistleAction)(void));
+#include "EventDispatcher.h"
+
+extern int main_events(const std::string& configFile, const std::string& inputFile, const WhistleHandler &whistleAction);
 extern void stopListening(int signal);
 
-void whistleAction(void)
+void whistleAction(const WhistleEvent &event)
 {
-    std::cout << "  !!! Whistle heard !!!" << std::endl;
+    std::cout << "  !!! Whistle " << (event.profile[0] ? std::string(event.profile) + " " : "") << "heard !!! (confidence " << event.confidence;
+    if(event.count > 1) {
+        std::cout << ", " << event.count << " detections";
+    }
+    std::cout << ")" << std::endl;
 }
 
+/* usage: whistle_detector_test [recording.wav|recording.raw [WhistleConfig.ini]] */
 int main(int argc, char **argv)
 {
     signal(SIGINT,  &stopListening);
     signal(SIGTERM, &stopListening);
-    main_loop("WhistleConfig.ini", &whistleAction);
+
+    const std::string inputFile  = (argc > 1) ? argv[1] : "";
+    const std::string configFile = (argc > 2) ? argv[2] : "WhistleConfig.ini";
+    main_events(configFile, inputFile, &whistleAction);
 }
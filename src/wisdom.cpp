@@ -0,0 +1,71 @@
+// generates FFTW wisdom for the transforms of a whistle detector configuration
+
+#include <iostream>
+#include <string>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+
+#include "Planner.h"
+#include "SoundConfig.h"
+#include "Timing.h"
+
+/* plans count transforms of size n with FFTW_PATIENT, usable for FFTW_MEASURE requests */
+static bool plan(int n, int count)
+{
+    float *in = static_cast<float*>(fftwf_malloc(sizeof(float) * n * count));
+    fftwf_complex *out = static_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * (n / 2 + 1) * count));
+
+    const uint64_t begin = Timing::now();
+    fftwf_plan p = planTransforms(n, count, in, out, FFTW_PATIENT);
+    std::cout << count << " x " << n << " points planned in " << (Timing::now() - begin) / 1000000 << " ms." << std::endl;
+
+    if(p) {
+        destroyPlan(p);
+    }
+    fftwf_free(in);
+    fftwf_free(out);
+    return p != NULL;
+}
+
+/* usage: whistle_detector_wisdom [WhistleConfig.ini [wisdom file]] */
+int main(int argc, char **argv)
+{
+    const std::string configFile = (argc > 1) ? argv[1] : "WhistleConfig.ini";
+
+    boost::property_tree::ptree iniConfig;
+    boost::property_tree::ini_parser::read_ini(configFile, iniConfig);
+
+    const int windowSizePadded  = iniConfig.get<int>("Time.WindowSizePadded");
+    const int windowSkipping    = iniConfig.get<int>("Time.WindowSkipping");
+    const int periodSize        = iniConfig.get<int>("Capture.PeriodSize", BUFFER_SIZE_RX);
+    const short channels        = iniConfig.get<short>("Capture.Channels", NUM_CHANNELS_RX);
+    const bool fusion           = iniConfig.get<std::string>("Engine.Fusion", "none") != "none";
+    const std::string wisdomFile = (argc > 2) ? argv[2] : iniConfig.get<std::string>("FFTW.Wisdom", "");
+
+    if(wisdomFile.empty()) {
+        std::cerr << "No wisdom file given and none configured in " << configFile << "!" << std::endl;
+        return 1;
+    }
+    if(windowSizePadded <= 0 || windowSkipping <= 0 || periodSize <= 0) {
+        std::cerr << "Window sizes and period size must be positive!" << std::endl;
+        return 1;
+    }
+
+    /* keep the plans of other configurations */
+    setPlanning(wisdomFile, false);
+    importWisdom(wisdomFile);
+
+    /* per window and a full batch of a period, as STFT plans them, and one window per channel
+     * for the channel fusion */
+    const int maxBatch = periodSize / windowSkipping + 1;
+    if(!plan(windowSizePadded, 1) || !plan(windowSizePadded, maxBatch) || (fusion && channels > 1 && !plan(windowSizePadded, channels))) {
+        std::cerr << "Planning failed!" << std::endl;
+        return 1;
+    }
+
+    if(!exportWisdom()) {
+        return 1;
+    }
+    std::cout << "Wisdom written to " << wisdomFile << "." << std::endl;
+    return 0;
+}